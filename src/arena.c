@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "simd.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Hand out an aligned block, moving to the next chunk when the current is full
+///////////////////////////////////////////////////////////////////////////////
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    arena_chunk_t *chunk = arena->current;
+    if (chunk == NULL || chunk->used + size > chunk->size)
+    {
+        // Pasamos al siguiente trozo de frames anteriores, y solo si no existe
+        // o no cabe la petición reservamos uno nuevo delante de él
+        arena_chunk_t *next = chunk != NULL ? chunk->next : arena->first;
+        if (next == NULL || size > next->size)
+        {
+            arena_chunk_t *new_chunk = (arena_chunk_t *)malloc(sizeof(arena_chunk_t));
+            new_chunk->size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+            new_chunk->data = (char *)simd_alloc(new_chunk->size);
+            new_chunk->next = next;
+            if (chunk != NULL)
+                chunk->next = new_chunk;
+            else
+                arena->first = new_chunk;
+            next = new_chunk;
+        }
+
+        // El trozo se vacía al empezar a usarlo, por eso el reset no tiene que recorrerlos
+        next->used = 0;
+        chunk = arena->current = next;
+    }
+
+    void *block = chunk->data + chunk->used;
+    chunk->used += size;
+
+    arena->used += size;
+    if (arena->used > arena->high_water_mark)
+        arena->high_water_mark = arena->used;
+
+    return block;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Release every block at once in O(1), the chunks are kept for reuse
+///////////////////////////////////////////////////////////////////////////////
+void reset_arena(arena_t *arena)
+{
+    arena->current = NULL;
+    arena->used = 0;
+}
+
+size_t get_arena_used(arena_t *arena)
+{
+    return arena->used;
+}
+
+size_t get_arena_high_water_mark(arena_t *arena)
+{
+    return arena->high_water_mark;
+}
+
+void free_arena(arena_t *arena)
+{
+    arena_chunk_t *chunk = arena->first;
+    while (chunk != NULL)
+    {
+        arena_chunk_t *next = chunk->next;
+        simd_free(chunk->data);
+        free(chunk);
+        chunk = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+}
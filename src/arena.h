@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Tamaño mínimo de cada trozo que reserva la arena (las peticiones mayores tienen uno propio)
+#define ARENA_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Todas las reservas quedan alineadas para poder usarlas con los kernels SIMD
+#define ARENA_ALIGNMENT 32
+
+typedef struct arena_chunk_t
+{
+    struct arena_chunk_t *next;
+    char *data;
+    size_t size;
+    size_t used;
+} arena_chunk_t;
+
+// Reserva lineal: se pide memoria avanzando un puntero y se libera toda de golpe
+// con reset_arena. Los trozos se conservan entre resets, así que en estado estable
+// no se llama nunca a malloc. No es segura entre hilos, se reserva desde el hilo principal
+typedef struct arena_t
+{
+    arena_chunk_t *first;
+    arena_chunk_t *current; // NULL justo después de un reset
+    size_t used;            // bytes entregados desde el último reset
+    size_t high_water_mark; // máximo de bytes entregados entre dos resets
+} arena_t;
+
+void *arena_alloc(arena_t *arena, size_t size);
+void reset_arena(arena_t *arena);
+size_t get_arena_used(arena_t *arena);
+size_t get_arena_high_water_mark(arena_t *arena);
+void free_arena(arena_t *arena);
+
+#endif
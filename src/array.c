@@ -40,6 +40,15 @@ int array_length(void *array)
     return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
 }
 
+// Vacía el array conservando su capacidad para reutilizarlo sin volver a reservar memoria
+void array_clear(void *array)
+{
+    if (array != NULL)
+    {
+        ARRAY_OCCUPIED(array) = 0;
+    }
+}
+
 void array_free(void *array)
 {
     if (array != NULL)
@@ -7,8 +7,13 @@
         (array)[array_length(array) - 1] = (value);                           \
     } while (0);
 
+// Capacidad y ocupados van en dos ints justo antes de los datos, los arrays que se
+// proyectan desde disco (la caché de mallas) guardan esa misma cabecera en el fichero
+#define ARRAY_HEADER_SIZE (sizeof(int) * 2)
+
 void* array_hold(void* array, int count, int item_size);
 int array_length(void* array);
+void array_clear(void* array);
 void array_free(void* array);
 
 #endif
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "asset_cache.h"
+#include "array.h"
+#include "lod.h"
+#include "vertex_cache.h"
+#include "mesh_cache.h"
+#include "texture_cache.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Shared geometry and texture resources
+///////////////////////////////////////////////////////////////////////////////
+// Cada OBJ y cada PNG se lee y se decodifica una sola vez. Si se vuelve a
+// pedir la misma ruta se devuelve el recurso ya cargado sin tocar el disco,
+// y si es una ruta nueva pero su contenido coincide con otro fichero ya
+// cargado se comparte también, la ruta queda como un alias. El hash y el
+// tamaño solo eligen candidatos, antes de compartir se comparan los bytes
+///////////////////////////////////////////////////////////////////////////////
+static asset_entry_t *geometry_entries = NULL;
+static asset_entry_t *texture_entries = NULL;
+
+// Recursos distintos, cada uno una sola vez aunque tenga varias rutas
+static mesh_geometry_t **geometries = NULL;
+static texture_t **textures = NULL;
+
+// Los hilos de carga consultan y registran recursos a la vez, el mutex solo
+// protege las tablas: leer, parsear y decodificar se hace sin tenerlo
+static SDL_mutex *cache_mutex = NULL;
+
+void init_asset_cache(void)
+{
+    cache_mutex = SDL_CreateMutex();
+}
+
+// FNV-1a de 64 bits sobre el contenido del fichero
+static uint64_t hash_bytes(const unsigned char *bytes, long size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (long i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static unsigned char *read_file(char *filename, long *size)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *bytes = (unsigned char *)malloc(*size > 0 ? *size : 1);
+    if (fread(bytes, 1, *size, file) != (size_t)*size)
+    {
+        free(bytes);
+        bytes = NULL;
+    }
+    fclose(file);
+    return bytes;
+}
+
+static void *find_by_path(asset_entry_t *entries, char *path)
+{
+    for (int i = 0; i < array_length(entries); i++)
+        if (strcmp(entries[i].path, path) == 0)
+            return entries[i].resource;
+    return NULL;
+}
+
+static bool same_file_contents(char *filename_a, char *filename_b)
+{
+    long size_a, size_b;
+    unsigned char *bytes_a = read_file(filename_a, &size_a);
+    unsigned char *bytes_b = read_file(filename_b, &size_b);
+    bool same = bytes_a != NULL && bytes_b != NULL && size_a == size_b && memcmp(bytes_a, bytes_b, size_a) == 0;
+    free(bytes_a);
+    free(bytes_b);
+    return same;
+}
+
+// Busca un recurso con el mismo contenido que path a partir de la entrada checked.
+// Las entradas solo se añaden y su ruta no se libera hasta el final, así que la
+// comparación de ficheros se hace con una copia de la entrada y sin el mutex
+static void *find_by_contents(asset_entry_t **entries, int *checked, uint64_t hash, int64_t size, char *path)
+{
+    for (;;)
+    {
+        SDL_LockMutex(cache_mutex);
+        bool pending = *checked < array_length(*entries);
+        asset_entry_t entry = pending ? (*entries)[*checked] : (asset_entry_t){0};
+        SDL_UnlockMutex(cache_mutex);
+        if (!pending)
+            return NULL;
+
+        (*checked)++;
+        if (entry.hash == hash && entry.size == size && same_file_contents(entry.path, path))
+            return entry.resource;
+    }
+}
+
+static void add_entry(asset_entry_t **entries, char *path, uint64_t hash, int64_t size, void *resource)
+{
+    asset_entry_t entry = {
+        .path = strdup(path),
+        .hash = hash,
+        .size = size,
+        .resource = resource,
+    };
+    array_push(*entries, entry);
+}
+
+// Parseamos el OBJ y lo dejamos listo para dibujar: caras ordenadas y niveles de detalle
+static mesh_geometry_t *process_geometry(char *obj_filename)
+{
+    mesh_geometry_t *geometry = (mesh_geometry_t *)calloc(1, sizeof(mesh_geometry_t));
+    load_mesh_obj_data(geometry, obj_filename);
+
+    // Ordenamos las caras para la caché de vértices antes de simplificar, cada nivel
+    // sale de las caras del anterior y lo volvemos a ordenar después
+    float acmr_before = get_mesh_acmr(geometry, VERTEX_CACHE_SIZE);
+    optimize_mesh_vertex_cache(geometry);
+    build_mesh_lods(geometry);
+    for (int i = 1; i < geometry->num_lods; i++)
+        optimize_mesh_vertex_cache(geometry->lods[i]);
+    printf("%s: ACMR %.3f -> %.3f (%d faces, FIFO cache of %d)\n", obj_filename, acmr_before,
+           get_mesh_acmr(geometry, VERTEX_CACHE_SIZE), array_length(geometry->faces), VERTEX_CACHE_SIZE);
+
+    return geometry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Return the geometry of an OBJ file, parsing it only the first time
+///////////////////////////////////////////////////////////////////////////////
+// Si junto al OBJ hay una caché binaria de la misma fecha y tamaño la
+// proyectamos sin leer el OBJ (su hash viene en la caché). Si la fecha no
+// coincide leemos el OBJ y la caché solo vale si el tamaño y el hash son los mismos
+///////////////////////////////////////////////////////////////////////////////
+mesh_geometry_t *get_cached_geometry(char *obj_filename)
+{
+    SDL_LockMutex(cache_mutex);
+    mesh_geometry_t *geometry = find_by_path(geometry_entries, obj_filename);
+    SDL_UnlockMutex(cache_mutex);
+    if (geometry != NULL)
+        return geometry;
+
+    file_info_t source_info;
+    if (!get_file_info(obj_filename, &source_info))
+        return NULL;
+
+    file_info_t cached_info;
+    uint64_t hash = 0;
+    mesh_geometry_t *loaded = map_mesh_cache(obj_filename, &cached_info, &hash);
+    if (loaded == NULL || cached_info.mtime != source_info.mtime || cached_info.size != source_info.size)
+    {
+        long size;
+        unsigned char *bytes = read_file(obj_filename, &size);
+        if (bytes == NULL)
+        {
+            if (loaded != NULL)
+                free_mesh_geometry(loaded);
+            return NULL;
+        }
+        uint64_t cached_hash = hash;
+        hash = hash_bytes(bytes, size);
+        free(bytes);
+
+        if (loaded != NULL && (cached_hash != hash || cached_info.size != source_info.size))
+        {
+            free_mesh_geometry(loaded);
+            loaded = NULL;
+        }
+    }
+
+    int checked = 0;
+    geometry = find_by_contents(&geometry_entries, &checked, hash, source_info.size, obj_filename);
+
+    if (geometry == NULL && loaded == NULL)
+    {
+        loaded = process_geometry(obj_filename);
+        write_mesh_cache(loaded, obj_filename, source_info, hash);
+    }
+
+    // Otro hilo puede haber registrado el mismo contenido mientras cargábamos, gana el primero.
+    // Solo registramos cuando ya no quedan entradas nuevas por comparar
+    SDL_LockMutex(cache_mutex);
+    while (geometry == NULL && checked < array_length(geometry_entries))
+    {
+        SDL_UnlockMutex(cache_mutex);
+        geometry = find_by_contents(&geometry_entries, &checked, hash, source_info.size, obj_filename);
+        SDL_LockMutex(cache_mutex);
+    }
+    if (geometry == NULL)
+    {
+        geometry = loaded;
+        loaded = NULL;
+        geometry->id = array_length(geometries);
+        array_push(geometries, geometry);
+    }
+    if (find_by_path(geometry_entries, obj_filename) == NULL)
+        add_entry(&geometry_entries, obj_filename, hash, source_info.size, geometry);
+    SDL_UnlockMutex(cache_mutex);
+
+    // Mismo contenido que otra ruta ya cargada, lo que hemos cargado sobra
+    if (loaded != NULL)
+        free_mesh_geometry(loaded);
+    return geometry;
+}
+
+// Decodificamos desde los bytes ya leídos, upng no se queda con el buffer
+static texture_t *decode_texture(unsigned char *bytes, long size)
+{
+    upng_t *png = upng_new_from_bytes(bytes, size);
+    if (png == NULL)
+        return NULL;
+
+    texture_t *texture = NULL;
+    upng_decode(png);
+    if (upng_get_error(png) == UPNG_EOK)
+        texture = create_texture_from_png(png);
+    upng_free(png);
+    return texture;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Return the texture of a PNG file, decoding it only the first time
+///////////////////////////////////////////////////////////////////////////////
+// Igual que con las mallas, si la caché de texels es de la misma fecha y
+// tamaño que el PNG se proyecta sin leerlo. upng no tiene estado global (sus
+// árboles de Huffman van en la pila), así que cada hilo puede decodificar su
+// propio upng_t a la vez que los demás
+///////////////////////////////////////////////////////////////////////////////
+texture_t *get_cached_texture(char *png_filename)
+{
+    SDL_LockMutex(cache_mutex);
+    texture_t *texture = find_by_path(texture_entries, png_filename);
+    SDL_UnlockMutex(cache_mutex);
+    if (texture != NULL)
+        return texture;
+
+    file_info_t source_info;
+    if (!get_file_info(png_filename, &source_info))
+        return NULL;
+
+    file_info_t cached_info;
+    uint64_t hash = 0;
+    unsigned char *bytes = NULL;
+    long size = 0;
+    texture_t *loaded = map_texture_cache(png_filename, &cached_info, &hash);
+    if (loaded == NULL || cached_info.mtime != source_info.mtime || cached_info.size != source_info.size)
+    {
+        bytes = read_file(png_filename, &size);
+        if (bytes == NULL)
+        {
+            if (loaded != NULL)
+                free_texture(loaded);
+            return NULL;
+        }
+        uint64_t cached_hash = hash;
+        hash = hash_bytes(bytes, size);
+
+        if (loaded != NULL && (cached_hash != hash || cached_info.size != source_info.size))
+        {
+            free_texture(loaded);
+            loaded = NULL;
+        }
+    }
+
+    int checked = 0;
+    texture = find_by_contents(&texture_entries, &checked, hash, source_info.size, png_filename);
+
+    if (texture == NULL && loaded == NULL)
+    {
+        loaded = decode_texture(bytes, size);
+        if (loaded == NULL)
+        {
+            free(bytes);
+            return NULL;
+        }
+        write_texture_cache(loaded, png_filename, source_info, hash);
+    }
+    free(bytes);
+
+    // Otro hilo puede haber registrado el mismo contenido mientras cargábamos, gana el primero
+    SDL_LockMutex(cache_mutex);
+    while (texture == NULL && checked < array_length(texture_entries))
+    {
+        SDL_UnlockMutex(cache_mutex);
+        texture = find_by_contents(&texture_entries, &checked, hash, source_info.size, png_filename);
+        SDL_LockMutex(cache_mutex);
+    }
+    if (texture == NULL)
+    {
+        texture = loaded;
+        loaded = NULL;
+        texture->id = array_length(textures);
+        array_push(textures, texture);
+    }
+    if (find_by_path(texture_entries, png_filename) == NULL)
+        add_entry(&texture_entries, png_filename, hash, source_info.size, texture);
+    SDL_UnlockMutex(cache_mutex);
+
+    if (loaded != NULL)
+        free_texture(loaded);
+    return texture;
+}
+
+int get_num_cached_geometries(void)
+{
+    SDL_LockMutex(cache_mutex);
+    int num_geometries = array_length(geometries);
+    SDL_UnlockMutex(cache_mutex);
+    return num_geometries;
+}
+
+void free_asset_cache(void)
+{
+    for (int i = 0; i < array_length(geometry_entries); i++)
+        free(geometry_entries[i].path);
+    for (int i = 0; i < array_length(texture_entries); i++)
+        free(texture_entries[i].path);
+    for (int i = 0; i < array_length(geometries); i++)
+        free_mesh_geometry(geometries[i]);
+    for (int i = 0; i < array_length(textures); i++)
+        free_texture(textures[i]);
+
+    array_free(geometry_entries);
+    array_free(texture_entries);
+    array_free(geometries);
+    array_free(textures);
+    SDL_DestroyMutex(cache_mutex);
+}
@@ -0,0 +1,24 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <stdint.h>
+#include "mesh.h"
+#include "texture.h"
+
+// Recurso cargado desde un fichero, identificado por su ruta y por el hash de su contenido
+// El hash solo descarta candidatos, dos rutas comparten recurso si sus bytes son iguales
+typedef struct asset_entry_t
+{
+    char *path;
+    uint64_t hash;
+    int64_t size; // tamaño del fichero fuente
+    void *resource; // mesh_geometry_t* o texture_t*
+} asset_entry_t;
+
+void init_asset_cache(void);
+mesh_geometry_t *get_cached_geometry(char *obj_filename);
+texture_t *get_cached_texture(char *png_filename);
+int get_num_cached_geometries(void);
+void free_asset_cache(void);
+
+#endif
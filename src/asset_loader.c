@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "asset_loader.h"
+#include "array.h"
+#include "asset_cache.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Background asset loading
+///////////////////////////////////////////////////////////////////////////////
+// load_mesh_async devuelve enseguida la instancia, pero fuera de la escena.
+// El OBJ y el PNG se encolan como dos trabajos independientes (un fichero que
+// ya está en cola no se vuelve a pedir) y los hilos de carga los leen y
+// decodifican en paralelo a través de la caché de recursos. Una vez por frame
+// el hilo principal mete en la escena las mallas que ya tienen geometría y
+// textura, así que el render nunca ve una malla a medias y mientras tanto
+// simplemente no la dibuja
+///////////////////////////////////////////////////////////////////////////////
+static SDL_Thread *loader_threads[ASSET_LOADER_THREADS];
+static int num_loader_threads = 0;
+static SDL_mutex *loader_mutex = NULL;
+static SDL_cond *job_available = NULL;
+static SDL_cond *job_finished = NULL;
+static bool is_quitting = false;
+
+// Cola de trabajos sin empezar y cuántos se están cargando ahora mismo
+static asset_job_t *queue_head = NULL;
+static asset_job_t *queue_tail = NULL;
+static int num_running_jobs = 0;
+
+// Solo los toca el hilo principal
+static asset_job_t **jobs = NULL;
+static pending_mesh_t *pending_meshes = NULL;
+static mesh_t **failed_meshes = NULL; // se guardan hasta el final para que su handle siga siendo válido
+
+static int loader_main(void *data)
+{
+    SDL_LockMutex(loader_mutex);
+    while (true)
+    {
+        while (!is_quitting && queue_head == NULL)
+            SDL_CondWait(job_available, loader_mutex);
+        if (is_quitting)
+            break;
+
+        asset_job_t *job = queue_head;
+        queue_head = job->next;
+        if (queue_head == NULL)
+            queue_tail = NULL;
+        num_running_jobs++;
+        SDL_UnlockMutex(loader_mutex);
+
+        void *resource = job->kind == ASSET_GEOMETRY
+                             ? (void *)get_cached_geometry(job->path)
+                             : (void *)get_cached_texture(job->path);
+
+        SDL_LockMutex(loader_mutex);
+        job->resource = resource;
+        job->is_done = true;
+        num_running_jobs--;
+        SDL_CondBroadcast(job_finished);
+    }
+    SDL_UnlockMutex(loader_mutex);
+    return 0;
+}
+
+void init_asset_loader(void)
+{
+    loader_mutex = SDL_CreateMutex();
+    job_available = SDL_CreateCond();
+    job_finished = SDL_CreateCond();
+
+    for (int i = 0; i < ASSET_LOADER_THREADS; i++)
+    {
+        loader_threads[i] = SDL_CreateThread(loader_main, "loader", NULL);
+        if (loader_threads[i] == NULL)
+        {
+            fprintf(stderr, "Error creating loader thread %d.\n", i);
+            break;
+        }
+        num_loader_threads++;
+    }
+}
+
+// Devuelve el trabajo de un fichero, encolándolo si nadie lo había pedido aún
+static asset_job_t *request_asset(int kind, char *path)
+{
+    for (int i = 0; i < array_length(jobs); i++)
+        if (jobs[i]->kind == kind && strcmp(jobs[i]->path, path) == 0)
+            return jobs[i];
+
+    asset_job_t *job = (asset_job_t *)calloc(1, sizeof(asset_job_t));
+    job->kind = kind;
+    job->path = strdup(path);
+    array_push(jobs, job);
+
+    // Sin hilos de carga lo hacemos aquí mismo
+    if (num_loader_threads == 0)
+    {
+        job->resource = kind == ASSET_GEOMETRY ? (void *)get_cached_geometry(path) : (void *)get_cached_texture(path);
+        job->is_done = true;
+        return job;
+    }
+
+    SDL_LockMutex(loader_mutex);
+    if (queue_tail != NULL)
+        queue_tail->next = job;
+    else
+        queue_head = job;
+    queue_tail = job;
+    SDL_CondSignal(job_available);
+    SDL_UnlockMutex(loader_mutex);
+    return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Request a mesh, it joins the scene once its files have been loaded
+///////////////////////////////////////////////////////////////////////////////
+// La instancia que devuelve sirve de handle: se puede mover o marcar como
+// oclusora desde ya, y is_mesh_loaded dice cuándo está en la escena
+///////////////////////////////////////////////////////////////////////////////
+mesh_t *load_mesh_async(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation)
+{
+    mesh_t source = {0};
+    pending_mesh_t pending = {
+        .mesh = create_mesh_instance(&source, scale, translation, rotation),
+        .geometry_job = request_asset(ASSET_GEOMETRY, obj_filename),
+        .texture_job = request_asset(ASSET_TEXTURE, png_filename),
+    };
+    array_push(pending_meshes, pending);
+    return pending.mesh;
+}
+
+bool is_mesh_loaded(mesh_t *mesh)
+{
+    return mesh->geometry != NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Add the meshes whose files are ready to the scene, call once per frame
+///////////////////////////////////////////////////////////////////////////////
+// Devuelve cuántas mallas han entrado; las que no tienen geometría no entran nunca
+int update_asset_loader(void)
+{
+    int num_added = 0;
+    int num_pending = 0;
+
+    SDL_LockMutex(loader_mutex);
+    for (int i = 0; i < array_length(pending_meshes); i++)
+    {
+        pending_mesh_t pending = pending_meshes[i];
+        if (!pending.geometry_job->is_done || !pending.texture_job->is_done)
+        {
+            pending_meshes[num_pending++] = pending;
+            continue;
+        }
+
+        if (pending.geometry_job->resource == NULL)
+        {
+            fprintf(stderr, "Error loading %s.\n", pending.geometry_job->path);
+            array_push(failed_meshes, pending.mesh);
+            continue;
+        }
+        pending.mesh->geometry = (mesh_geometry_t *)pending.geometry_job->resource;
+        pending.mesh->texture = (texture_t *)pending.texture_job->resource;
+        add_mesh_to_scene(pending.mesh);
+        num_added++;
+    }
+    SDL_UnlockMutex(loader_mutex);
+
+    if (pending_meshes != NULL)
+    {
+        array_clear(pending_meshes);
+        if (num_pending > 0)
+            pending_meshes = array_hold(pending_meshes, num_pending, sizeof(pending_mesh_t));
+    }
+    return num_added;
+}
+
+// Espera a que terminen todos los trabajos pedidos y mete sus mallas en la escena
+void wait_asset_loader(void)
+{
+    SDL_LockMutex(loader_mutex);
+    while (queue_head != NULL || num_running_jobs > 0)
+        SDL_CondWait(job_finished, loader_mutex);
+    SDL_UnlockMutex(loader_mutex);
+
+    update_asset_loader();
+}
+
+int get_num_pending_meshes(void)
+{
+    return array_length(pending_meshes);
+}
+
+void free_asset_loader(void)
+{
+    // Los trabajos en marcha terminan, los que siguen en la cola se abandonan
+    SDL_LockMutex(loader_mutex);
+    is_quitting = true;
+    SDL_CondBroadcast(job_available);
+    SDL_UnlockMutex(loader_mutex);
+
+    for (int i = 0; i < num_loader_threads; i++)
+        SDL_WaitThread(loader_threads[i], NULL);
+    num_loader_threads = 0;
+
+    for (int i = 0; i < array_length(pending_meshes); i++)
+        free(pending_meshes[i].mesh);
+    for (int i = 0; i < array_length(failed_meshes); i++)
+        free(failed_meshes[i]);
+    for (int i = 0; i < array_length(jobs); i++)
+    {
+        free(jobs[i]->path);
+        free(jobs[i]);
+    }
+    array_free(pending_meshes);
+    array_free(failed_meshes);
+    array_free(jobs);
+
+    SDL_DestroyCond(job_available);
+    SDL_DestroyCond(job_finished);
+    SDL_DestroyMutex(loader_mutex);
+}
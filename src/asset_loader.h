@@ -0,0 +1,43 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <stdbool.h>
+#include "mesh.h"
+
+// Hilos que leen y decodifican ficheros en segundo plano, aparte del pool del render
+// (los trozos de un OBJ sí se reparten entre los workers del pool)
+#define ASSET_LOADER_THREADS 4
+
+enum asset_kind
+{
+    ASSET_GEOMETRY,
+    ASSET_TEXTURE
+};
+
+// Un fichero pendiente de cargar, varias mallas pueden esperar al mismo
+typedef struct asset_job_t
+{
+    int kind;
+    char *path;
+    void *resource;           // mesh_geometry_t* o texture_t*, NULL si no se pudo cargar
+    bool is_done;
+    struct asset_job_t *next; // siguiente en la cola de trabajos
+} asset_job_t;
+
+// Malla pedida que entra en la escena cuando su geometría y su textura están listas
+typedef struct pending_mesh_t
+{
+    mesh_t *mesh;
+    asset_job_t *geometry_job;
+    asset_job_t *texture_job;
+} pending_mesh_t;
+
+void init_asset_loader(void);
+mesh_t *load_mesh_async(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation);
+bool is_mesh_loaded(mesh_t *mesh);
+int update_asset_loader(void);
+void wait_asset_loader(void);
+int get_num_pending_meshes(void);
+void free_asset_loader(void);
+
+#endif
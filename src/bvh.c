@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include "bvh.h"
+#include "array.h"
+#include "clipping.h"
+#include "stats.h"
+#include "transform.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Bounding volume hierarchy of the scene
+///////////////////////////////////////////////////////////////////////////////
+// Cada malla es una hoja con su caja de mundo y cada nodo interno envuelve a
+// sus dos hijos. El frustum se prueba de la raíz hacia abajo: una rama entera
+// fuera de un plano no se visita, y una rama entera dentro de todos los planos
+// aporta sus mallas de golpe (el rango [first, first + count) del orden de la
+// jerarquía) sin probar ningún nodo más. Así el coste por frame crece con las
+// ramas que cruzan los bordes del frustum y no con el número de mallas.
+//
+// Cuando una malla se mueve solo se reajustan las cajas de su camino hasta la
+// raíz; la jerarquía entera se reconstruye únicamente si cambia el número de mallas
+///////////////////////////////////////////////////////////////////////////////
+static bvh_node_t *nodes = NULL;
+static int num_nodes = 0;
+
+// Mallas en el orden de las hojas, cada subárbol ocupa un rango contiguo
+static mesh_t **ordered_meshes = NULL;
+static int num_bvh_meshes = 0;
+
+// Resultado del recorrido y pila del recorrido (índice del nodo y planos por probar)
+static mesh_t **visible_meshes_list = NULL;
+static int *stack_nodes = NULL;
+static int *stack_planes = NULL;
+
+static float get_axis(vec3_t v, int axis)
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static vec3_t vec3_min(vec3_t a, vec3_t b)
+{
+    return vec3_new(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+}
+
+static vec3_t vec3_max(vec3_t a, vec3_t b)
+{
+    return vec3_new(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Build the subtree of the meshes in [first, first + count), top-down
+///////////////////////////////////////////////////////////////////////////////
+static int build_node(int first, int count, int parent)
+{
+    int index = num_nodes++;
+    bvh_node_t *node = &nodes[index];
+    node->parent = parent;
+    node->first = first;
+    node->count = count;
+    node->left = -1;
+    node->right = -1;
+
+    // Caja del nodo y caja de los centros de las mallas (para elegir el corte)
+    node->bounds_min = ordered_meshes[first]->world_bounds_min;
+    node->bounds_max = ordered_meshes[first]->world_bounds_max;
+    vec3_t centroid_min = vec3_mul(vec3_add(node->bounds_min, node->bounds_max), 0.5);
+    vec3_t centroid_max = centroid_min;
+    for (int i = first + 1; i < first + count; i++)
+    {
+        mesh_t *mesh = ordered_meshes[i];
+        vec3_t centroid = vec3_mul(vec3_add(mesh->world_bounds_min, mesh->world_bounds_max), 0.5);
+        node->bounds_min = vec3_min(node->bounds_min, mesh->world_bounds_min);
+        node->bounds_max = vec3_max(node->bounds_max, mesh->world_bounds_max);
+        centroid_min = vec3_min(centroid_min, centroid);
+        centroid_max = vec3_max(centroid_max, centroid);
+    }
+
+    if (count == 1)
+    {
+        ordered_meshes[first]->bvh_node = index;
+        return index;
+    }
+
+    // Cortamos por la mitad del eje más largo de los centros
+    vec3_t extent = vec3_sub(centroid_max, centroid_min);
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+    float split = 0.5 * (get_axis(centroid_min, axis) + get_axis(centroid_max, axis));
+
+    int middle = first;
+    for (int i = first; i < first + count; i++)
+    {
+        mesh_t *mesh = ordered_meshes[i];
+        float centroid = 0.5 * (get_axis(mesh->world_bounds_min, axis) + get_axis(mesh->world_bounds_max, axis));
+        if (centroid < split)
+        {
+            ordered_meshes[i] = ordered_meshes[middle];
+            ordered_meshes[middle++] = mesh;
+        }
+    }
+
+    // Si todos los centros coinciden partimos el rango por la mitad
+    if (middle == first || middle == first + count)
+        middle = first + count / 2;
+
+    // Los nodos están reservados de antemano, el puntero no cambia en la recursión
+    node->left = build_node(first, middle - first, index);
+    node->right = build_node(middle, first + count - middle, index);
+    return index;
+}
+
+static void build_scene_bvh(void)
+{
+    num_bvh_meshes = get_num_meshes();
+    num_nodes = 0;
+
+    // Un árbol binario con n hojas tiene 2n - 1 nodos
+    free(nodes);
+    free(ordered_meshes);
+    free(visible_meshes_list);
+    free(stack_nodes);
+    free(stack_planes);
+    nodes = (bvh_node_t *)malloc(sizeof(bvh_node_t) * (2 * num_bvh_meshes));
+    ordered_meshes = (mesh_t **)malloc(sizeof(mesh_t *) * (num_bvh_meshes + 1));
+    visible_meshes_list = (mesh_t **)malloc(sizeof(mesh_t *) * (num_bvh_meshes + 1));
+    stack_nodes = (int *)malloc(sizeof(int) * (2 * num_bvh_meshes));
+    stack_planes = (int *)malloc(sizeof(int) * (2 * num_bvh_meshes));
+
+    for (int i = 0; i < num_bvh_meshes; i++)
+        ordered_meshes[i] = get_mesh(i);
+
+    if (num_bvh_meshes > 0)
+        build_node(0, num_bvh_meshes, -1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Refit the boxes from the leaf of a mesh that has moved up to the root
+///////////////////////////////////////////////////////////////////////////////
+static void refit_bvh_leaf(mesh_t *mesh)
+{
+    int index = mesh->bvh_node;
+    nodes[index].bounds_min = mesh->world_bounds_min;
+    nodes[index].bounds_max = mesh->world_bounds_max;
+
+    // Subimos recalculando las cajas, en cuanto una no cambia las de arriba tampoco
+    for (index = nodes[index].parent; index >= 0; index = nodes[index].parent)
+    {
+        bvh_node_t *node = &nodes[index];
+        vec3_t bounds_min = vec3_min(nodes[node->left].bounds_min, nodes[node->right].bounds_min);
+        vec3_t bounds_max = vec3_max(nodes[node->left].bounds_max, nodes[node->right].bounds_max);
+        if (bounds_min.x == node->bounds_min.x && bounds_min.y == node->bounds_min.y && bounds_min.z == node->bounds_min.z &&
+            bounds_max.x == node->bounds_max.x && bounds_max.y == node->bounds_max.y && bounds_max.z == node->bounds_max.z)
+            break;
+        node->bounds_min = bounds_min;
+        node->bounds_max = bounds_max;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Update the world bounds of the meshes that have moved and refit the hierarchy
+///////////////////////////////////////////////////////////////////////////////
+void update_scene_bvh(void)
+{
+    bool is_stale = num_bvh_meshes != get_num_meshes();
+
+    mesh_t **dirty_meshes = get_dirty_meshes();
+    for (int i = 0; i < array_length(dirty_meshes); i++)
+    {
+        update_mesh_transform(dirty_meshes[i]);
+        if (!is_stale)
+            refit_bvh_leaf(dirty_meshes[i]);
+    }
+    clear_dirty_meshes();
+
+    if (is_stale)
+        build_scene_bvh();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Walk the hierarchy against the frustum and return the meshes that may be visible
+///////////////////////////////////////////////////////////////////////////////
+int cull_scene_bvh(mesh_t ***visible_meshes)
+{
+    *visible_meshes = visible_meshes_list;
+    if (num_nodes == 0)
+        return 0;
+
+    vec4_t planes[6];
+    get_world_frustum_planes(get_view_matrix(), planes);
+
+    int num_visible = 0;
+    int visited_nodes = 0;
+    int stack_size = 0;
+    stack_nodes[stack_size] = 0;
+    stack_planes[stack_size++] = FRUSTUM_OUTCODE_MASK;
+
+    while (stack_size > 0)
+    {
+        stack_size--;
+        bvh_node_t *node = &nodes[stack_nodes[stack_size]];
+        int node_planes = stack_planes[stack_size];
+        visited_nodes++;
+
+        // Solo probamos los planos que el padre todavía cruzaba
+        bool is_outside = false;
+        for (int plane = 0; plane < 6 && !is_outside; plane++)
+        {
+            if (!(node_planes & OUTCODE(plane)))
+                continue;
+
+            // Esquina de la caja más adentro del plano y la más afuera
+            vec4_t p = planes[plane];
+            vec3_t inner = {
+                .x = p.x >= 0 ? node->bounds_max.x : node->bounds_min.x,
+                .y = p.y >= 0 ? node->bounds_max.y : node->bounds_min.y,
+                .z = p.z >= 0 ? node->bounds_max.z : node->bounds_min.z,
+            };
+            vec3_t outer = {
+                .x = p.x >= 0 ? node->bounds_min.x : node->bounds_max.x,
+                .y = p.y >= 0 ? node->bounds_min.y : node->bounds_max.y,
+                .z = p.z >= 0 ? node->bounds_min.z : node->bounds_max.z,
+            };
+
+            if (p.x * inner.x + p.y * inner.y + p.z * inner.z + p.w < 0)
+                is_outside = true;
+            else if (p.x * outer.x + p.y * outer.y + p.z * outer.z + p.w > 0)
+                node_planes &= ~OUTCODE(plane);
+        }
+        if (is_outside)
+            continue;
+
+        // Dentro de todos los planos (o una hoja): todas sus mallas pasan
+        if (node_planes == 0 || node->left < 0)
+        {
+            for (int i = node->first; i < node->first + node->count; i++)
+                visible_meshes_list[num_visible++] = ordered_meshes[i];
+            continue;
+        }
+
+        stack_nodes[stack_size] = node->left;
+        stack_planes[stack_size++] = node_planes;
+        stack_nodes[stack_size] = node->right;
+        stack_planes[stack_size++] = node_planes;
+    }
+
+    add_stat(STAT_BVH_VISITED_NODES, visited_nodes);
+    return num_visible;
+}
+
+void free_scene_bvh(void)
+{
+    free(nodes);
+    free(ordered_meshes);
+    free(visible_meshes_list);
+    free(stack_nodes);
+    free(stack_planes);
+}
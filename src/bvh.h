@@ -0,0 +1,23 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "mesh.h"
+
+// Nodo de la jerarquía de volúmenes envolventes de la escena
+// Las hojas tienen una sola malla y los internos siempre dos hijos
+typedef struct bvh_node_t
+{
+    vec3_t bounds_min; // caja en espacio de mundo que envuelve todo el subárbol
+    vec3_t bounds_max;
+    int left;          // hijos, -1 en las hojas
+    int right;
+    int parent;        // -1 en la raíz
+    int first;         // rango de mallas del subárbol en el orden de la jerarquía
+    int count;
+} bvh_node_t;
+
+void update_scene_bvh(void);
+int cull_scene_bvh(mesh_t ***visible_meshes);
+void free_scene_bvh(void);
+
+#endif
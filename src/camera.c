@@ -1,6 +1,6 @@
 #include "camera.h"
 
-static camera_t camera;
+static camera_t camera = {.is_dirty = true};
 
 void init_camera(vec3_t position, vec3_t direction)
 {
@@ -9,6 +9,7 @@ void init_camera(vec3_t position, vec3_t direction)
     camera.forward_velocity = vec3_new(0, 0, 0);
     camera.yaw = 0.0;
     camera.pitch = 0.0;
+    camera.is_dirty = true;
 };
 
 vec3_t get_camera_position(void)
@@ -39,11 +40,13 @@ float get_camera_pitch(void)
 void update_camera_position(vec3_t position)
 {
     camera.position = position;
+    camera.is_dirty = true;
 }
 
 void update_camera_direction(vec3_t direction)
 {
     camera.direction = direction;
+    camera.is_dirty = true;
 }
 
 void update_camera_forward_velocity(vec3_t forward_velocity)
@@ -54,11 +57,13 @@ void update_camera_forward_velocity(vec3_t forward_velocity)
 void rotate_camera_yaw(float angle)
 {
     camera.yaw += angle;
+    camera.is_dirty = true;
 }
 
 void rotate_camera_pitch(float angle)
 {
     camera.pitch += angle;
+    camera.is_dirty = true;
 }
 
 vec3_t get_camera_lookat_target(void)
@@ -82,4 +87,14 @@ vec3_t get_camera_lookat_target(void)
     target = vec3_add(camera.position, camera.direction);
 
     return target;
+}
+
+bool is_camera_dirty(void)
+{
+    return camera.is_dirty;
+}
+
+void clear_camera_dirty(void)
+{
+    camera.is_dirty = false;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <stdbool.h>
 #include "vector.h"
 #include "matrix.h"
 
@@ -11,6 +12,7 @@ typedef struct camera_t
     vec3_t forward_velocity;
     float yaw;
     float pitch;
+    bool is_dirty; // la posición u orientación han cambiado desde la última vista
 } camera_t;
 
 void init_camera(vec3_t position, vec3_t direction);
@@ -30,4 +32,7 @@ void rotate_camera_pitch(float angle);
 
 vec3_t get_camera_lookat_target(void);
 
+bool is_camera_dirty(void);
+void clear_camera_dirty(void);
+
 #endif
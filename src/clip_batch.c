@@ -0,0 +1,230 @@
+#include <string.h>
+#include "clip_batch.h"
+#include "simd.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Batched clipper in homogeneous clip space
+///////////////////////////////////////////////////////////////////////////////
+// Recorta hasta ocho triángulos a la vez después de multiplicarlos por la
+// matriz de proyección. En espacio de recorte los planos del frustum son
+// simplemente -w <= x <= w, -w <= y <= w y 0 <= z <= w, así que la distancia
+// de un vértice a cada plano es una combinación de sus componentes que
+// calculamos para los ocho polígonos con una sola instrucción por vértice.
+//
+// Cada plano lee los polígonos de un buffer y escribe el resultado en el otro
+// (ping-pong), sin copiar de vuelta. Como es una transformación lineal de la
+// cámara, los puntos de corte son los mismos que en espacio de cámara
+///////////////////////////////////////////////////////////////////////////////
+
+// Distancia = a*x + b*y + c*z + d*w, positiva dentro, en el orden de los planos del frustum
+static const float plane_coefficients[6][4] = {
+    {1, 0, 0, 1},  // izquierda: x >= -w
+    {-1, 0, 0, 1}, // derecha: x <= w
+    {0, -1, 0, 1}, // arriba: y <= w
+    {0, 1, 0, 1},  // abajo: y >= -w
+    {0, 0, 1, 0},  // near: z >= 0
+    {0, 0, -1, 1}, // far: z <= w
+};
+
+void init_clip_batch(clip_batch_t *batch)
+{
+    // Los carriles vacíos también se leen en los kernels, mejor que no tengan basura
+    memset(batch, 0, sizeof(clip_batch_t));
+}
+
+void clear_clip_batch(clip_batch_t *batch)
+{
+    batch->count = 0;
+    batch->current = 0;
+}
+
+// Añade un triángulo en espacio de recorte y devuelve su carril en el lote
+int add_to_clip_batch(clip_batch_t *batch, vec4_t clip_points[3], tex2_t texcoords[3], int planes)
+{
+    int lane = batch->count++;
+    clip_polygons_t *polygons = &batch->polygons[batch->current];
+    for (int i = 0; i < 3; i++)
+    {
+        polygons->x[i][lane] = clip_points[i].x;
+        polygons->y[i][lane] = clip_points[i].y;
+        polygons->z[i][lane] = clip_points[i].z;
+        polygons->w[i][lane] = clip_points[i].w;
+        polygons->u[i][lane] = texcoords[i].u;
+        polygons->v[i][lane] = texcoords[i].v;
+    }
+    batch->planes[lane] = planes;
+    batch->num_vertices[lane] = 3;
+    return lane;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Distance of the first num_slots vertices of every polygon to a plane
+///////////////////////////////////////////////////////////////////////////////
+static void plane_distances_scalar(const float *plane, clip_polygons_t *polygons, int num_slots, float distances[][CLIP_BATCH_SIZE])
+{
+    for (int slot = 0; slot < num_slots; slot++)
+        for (int lane = 0; lane < CLIP_BATCH_SIZE; lane++)
+            distances[slot][lane] = plane[0] * polygons->x[slot][lane] + plane[1] * polygons->y[slot][lane] +
+                                    plane[2] * polygons->z[slot][lane] + plane[3] * polygons->w[slot][lane];
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2"))) static void plane_distances_sse2(const float *plane, clip_polygons_t *polygons, int num_slots, float distances[][CLIP_BATCH_SIZE])
+{
+    __m128 a = _mm_set1_ps(plane[0]);
+    __m128 b = _mm_set1_ps(plane[1]);
+    __m128 c = _mm_set1_ps(plane[2]);
+    __m128 d = _mm_set1_ps(plane[3]);
+    for (int slot = 0; slot < num_slots; slot++)
+    {
+        // Los ocho carriles en dos mitades de cuatro
+        for (int lane = 0; lane < CLIP_BATCH_SIZE; lane += 4)
+        {
+            __m128 distance = _mm_mul_ps(a, _mm_loadu_ps(&polygons->x[slot][lane]));
+            distance = _mm_add_ps(distance, _mm_mul_ps(b, _mm_loadu_ps(&polygons->y[slot][lane])));
+            distance = _mm_add_ps(distance, _mm_mul_ps(c, _mm_loadu_ps(&polygons->z[slot][lane])));
+            distance = _mm_add_ps(distance, _mm_mul_ps(d, _mm_loadu_ps(&polygons->w[slot][lane])));
+            _mm_storeu_ps(&distances[slot][lane], distance);
+        }
+    }
+}
+
+__attribute__((target("avx2"))) static void plane_distances_avx2(const float *plane, clip_polygons_t *polygons, int num_slots, float distances[][CLIP_BATCH_SIZE])
+{
+    __m256 a = _mm256_set1_ps(plane[0]);
+    __m256 b = _mm256_set1_ps(plane[1]);
+    __m256 c = _mm256_set1_ps(plane[2]);
+    __m256 d = _mm256_set1_ps(plane[3]);
+    for (int slot = 0; slot < num_slots; slot++)
+    {
+        // Sin FMA para dar exactamente el mismo resultado que los otros caminos
+        __m256 distance = _mm256_mul_ps(a, _mm256_loadu_ps(polygons->x[slot]));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(b, _mm256_loadu_ps(polygons->y[slot])));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(c, _mm256_loadu_ps(polygons->z[slot])));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(d, _mm256_loadu_ps(polygons->w[slot])));
+        _mm256_storeu_ps(distances[slot], distance);
+    }
+}
+#endif
+
+static void plane_distances(const float *plane, clip_polygons_t *polygons, int num_slots, float distances[][CLIP_BATCH_SIZE])
+{
+#ifdef SIMD_X86
+    if (get_simd_level() == SIMD_AVX2)
+    {
+        plane_distances_avx2(plane, polygons, num_slots, distances);
+        return;
+    }
+    if (get_simd_level() == SIMD_SSE2)
+    {
+        plane_distances_sse2(plane, polygons, num_slots, distances);
+        return;
+    }
+#endif
+    plane_distances_scalar(plane, polygons, num_slots, distances);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sutherland-Hodgman for one polygon of the batch with precomputed distances
+///////////////////////////////////////////////////////////////////////////////
+static void copy_clip_vertex(clip_polygons_t *src, int src_slot, clip_polygons_t *dst, int dst_slot, int lane)
+{
+    dst->x[dst_slot][lane] = src->x[src_slot][lane];
+    dst->y[dst_slot][lane] = src->y[src_slot][lane];
+    dst->z[dst_slot][lane] = src->z[src_slot][lane];
+    dst->w[dst_slot][lane] = src->w[src_slot][lane];
+    dst->u[dst_slot][lane] = src->u[src_slot][lane];
+    dst->v[dst_slot][lane] = src->v[src_slot][lane];
+}
+
+static void lerp_clip_vertex(clip_polygons_t *src, int a, int b, float t, clip_polygons_t *dst, int dst_slot, int lane)
+{
+    dst->x[dst_slot][lane] = src->x[a][lane] + t * (src->x[b][lane] - src->x[a][lane]);
+    dst->y[dst_slot][lane] = src->y[a][lane] + t * (src->y[b][lane] - src->y[a][lane]);
+    dst->z[dst_slot][lane] = src->z[a][lane] + t * (src->z[b][lane] - src->z[a][lane]);
+    dst->w[dst_slot][lane] = src->w[a][lane] + t * (src->w[b][lane] - src->w[a][lane]);
+    dst->u[dst_slot][lane] = src->u[a][lane] + t * (src->u[b][lane] - src->u[a][lane]);
+    dst->v[dst_slot][lane] = src->v[a][lane] + t * (src->v[b][lane] - src->v[a][lane]);
+}
+
+static void clip_lane_against_plane(clip_batch_t *batch, int lane, clip_polygons_t *src, clip_polygons_t *dst, float distances[][CLIP_BATCH_SIZE])
+{
+    int num_vertices = batch->num_vertices[lane];
+    int num_inside_vertices = 0;
+    if (num_vertices == 0)
+        return;
+
+    // Mismo criterio que clip_polygon_against_plane: cortamos si cambia de signo
+    // y nos quedamos con los vértices estrictamente dentro
+    int previous = num_vertices - 1;
+    float previous_distance = distances[previous][lane];
+    for (int current = 0; current < num_vertices; current++)
+    {
+        float current_distance = distances[current][lane];
+        if (current_distance * previous_distance < 0)
+        {
+            float t = previous_distance / (previous_distance - current_distance);
+            lerp_clip_vertex(src, previous, current, t, dst, num_inside_vertices++, lane);
+        }
+        if (current_distance > 0)
+            copy_clip_vertex(src, current, dst, num_inside_vertices++, lane);
+
+        previous = current;
+        previous_distance = current_distance;
+    }
+    batch->num_vertices[lane] = num_inside_vertices;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clip every polygon of the batch against the planes it crosses
+///////////////////////////////////////////////////////////////////////////////
+void run_clip_batch(clip_batch_t *batch)
+{
+    int batch_planes = 0;
+    for (int lane = 0; lane < batch->count; lane++)
+        batch_planes |= batch->planes[lane];
+
+    for (int plane = 0; plane < 6; plane++)
+    {
+        if (!(batch_planes & OUTCODE(plane)))
+            continue;
+
+        clip_polygons_t *src = &batch->polygons[batch->current];
+        clip_polygons_t *dst = &batch->polygons[1 - batch->current];
+
+        int max_vertices = 0;
+        for (int lane = 0; lane < batch->count; lane++)
+            if (batch->num_vertices[lane] > max_vertices)
+                max_vertices = batch->num_vertices[lane];
+
+        float distances[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+        plane_distances(plane_coefficients[plane], src, max_vertices, distances);
+
+        for (int lane = 0; lane < batch->count; lane++)
+        {
+            // Los polígonos que no cruzan el plano pasan tal cual al otro buffer
+            if (batch->planes[lane] & OUTCODE(plane))
+                clip_lane_against_plane(batch, lane, src, dst, distances);
+            else
+                for (int i = 0; i < batch->num_vertices[lane]; i++)
+                    copy_clip_vertex(src, i, dst, i, lane);
+        }
+        batch->current = 1 - batch->current;
+    }
+}
+
+int get_clip_batch_num_vertices(clip_batch_t *batch, int lane)
+{
+    return batch->num_vertices[lane];
+}
+
+void get_clip_batch_vertex(clip_batch_t *batch, int lane, int index, vec4_t *point, tex2_t *texcoord)
+{
+    clip_polygons_t *polygons = &batch->polygons[batch->current];
+    *point = (vec4_t){polygons->x[index][lane], polygons->y[index][lane], polygons->z[index][lane], polygons->w[index][lane]};
+    *texcoord = (tex2_t){polygons->u[index][lane], polygons->v[index][lane]};
+}
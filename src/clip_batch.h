@@ -0,0 +1,39 @@
+#ifndef CLIP_BATCH_H
+#define CLIP_BATCH_H
+
+#include "vector.h"
+#include "texture.h"
+#include "clipping.h"
+
+// Triángulos que se recortan a la vez, uno por carril de un registro AVX2
+#define CLIP_BATCH_SIZE 8
+
+// Polígonos del lote en espacio de recorte (homogéneo) guardados en SoA:
+// para cada vértice, el valor de los ocho polígonos va seguido
+typedef struct clip_polygons_t
+{
+    float x[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+    float y[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+    float z[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+    float w[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+    float u[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+    float v[MAX_NUM_POLY_VERTICES][CLIP_BATCH_SIZE];
+} clip_polygons_t;
+
+typedef struct clip_batch_t
+{
+    int count;                               // triángulos en el lote
+    int planes[CLIP_BATCH_SIZE];             // planos que cruza cada uno (bits de outcode)
+    int num_vertices[CLIP_BATCH_SIZE];       // vértices de cada polígono tras recortar
+    clip_polygons_t polygons[2];             // cada plano lee de uno y escribe en el otro
+    int current;                             // juego de polígonos con el resultado
+} clip_batch_t;
+
+void init_clip_batch(clip_batch_t *batch);
+void clear_clip_batch(clip_batch_t *batch);
+int add_to_clip_batch(clip_batch_t *batch, vec4_t clip_points[3], tex2_t texcoords[3], int planes);
+void run_clip_batch(clip_batch_t *batch);
+int get_clip_batch_num_vertices(clip_batch_t *batch, int lane);
+void get_clip_batch_vertex(clip_batch_t *batch, int lane, int index, vec4_t *point, tex2_t *texcoord);
+
+#endif
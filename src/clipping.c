@@ -2,8 +2,13 @@
 #include <math.h>
 
 #define NUM_PLANES 6
+#define NUM_GUARD_BAND_PLANES 4
 
 plane_t frustum_planes[NUM_PLANES];
+plane_t guard_band_planes[NUM_GUARD_BAND_PLANES];
+
+// Con la guard band solo se recortan near y far, los lados los recorta el rasterizador
+static bool is_guard_band = true;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Frustum planes are defined by a point and a normal vector
@@ -65,6 +70,52 @@ void init_frustum_planes(float fov_x, float fov_y, float z_near, float z_far)
     frustum_planes[FAR_FRUSTUM_PLANE].normal.z = -1;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Guard band planes: the side planes opened scale times wider
+///////////////////////////////////////////////////////////////////////////////
+// Un triángulo que se sale de la pantalla pero no de la guard band se puede
+// rasterizar sin recortar, el rectángulo de recorte de cada hilo (scissoring)
+// ya descarta los píxeles de fuera. Solo los que llegan más lejos, donde las
+// coordenadas en punto fijo podrían desbordar, se recortan contra los lados
+///////////////////////////////////////////////////////////////////////////////
+// La guard band se recorta en pantallas grandes para que el punto fijo del setup no desborde
+int get_guard_band_pixels(int width, int height)
+{
+    int largest_side = width > height ? width : height;
+    int guard_band = (MAX_RASTER_EXTENT - largest_side) / 2;
+    if (guard_band > GUARD_BAND_PIXELS)
+        guard_band = GUARD_BAND_PIXELS;
+    return guard_band > 0 ? guard_band : 0;
+}
+
+void init_guard_band_planes(float fov_x, float fov_y, float scale_x, float scale_y)
+{
+    float half_guard_x = atan(tan(fov_x / 2) * scale_x);
+    float half_guard_y = atan(tan(fov_y / 2) * scale_y);
+
+    guard_band_planes[LEFT_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guard_band_planes[LEFT_FRUSTUM_PLANE].normal = vec3_new(cos(half_guard_x), 0, sin(half_guard_x));
+
+    guard_band_planes[RIGHT_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guard_band_planes[RIGHT_FRUSTUM_PLANE].normal = vec3_new(-cos(half_guard_x), 0, sin(half_guard_x));
+
+    guard_band_planes[TOP_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guard_band_planes[TOP_FRUSTUM_PLANE].normal = vec3_new(0, -cos(half_guard_y), sin(half_guard_y));
+
+    guard_band_planes[BOTTOM_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guard_band_planes[BOTTOM_FRUSTUM_PLANE].normal = vec3_new(0, cos(half_guard_y), sin(half_guard_y));
+}
+
+void set_guard_band_clipping(bool enabled)
+{
+    is_guard_band = enabled;
+}
+
+bool is_guard_band_clipping(void)
+{
+    return is_guard_band;
+}
+
 polygon_t polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2)
 {
     polygon_t polygon = {
@@ -193,12 +244,93 @@ void clip_polygon_against_plane(polygon_t *polygon, int plane)
     polygon->num_vertices = num_inside_vertices;
 }
 
+// Un vértice que está dentro de los seis planos nunca será recortado, así que los
+// triángulos con los tres vértices dentro pueden saltarse el clipping por completo
+// (usamos el mismo criterio estricto que clip_polygon_against_plane)
+bool is_vertex_inside_plane(vec3_t vertex, int plane)
+{
+    vec3_t plane_point = frustum_planes[plane].point;
+    vec3_t plane_normal = frustum_planes[plane].normal;
+    return vec3_dot(vec3_sub(vertex, plane_point), plane_normal) > 0;
+}
+
+bool is_vertex_inside_frustum(vec3_t vertex)
+{
+    return get_vertex_outcode(vertex) == 0;
+}
+
+// Bits de los planos del frustum y de la guard band de los que queda fuera el vértice
+int get_vertex_outcode(vec3_t vertex)
+{
+    int outcode = 0;
+    for (int plane = 0; plane < NUM_PLANES; plane++)
+        if (!is_vertex_inside_plane(vertex, plane))
+            outcode |= OUTCODE(plane);
+
+    for (int plane = 0; plane < NUM_GUARD_BAND_PLANES; plane++)
+        if (!(vec3_dot(vec3_sub(vertex, guard_band_planes[plane].point), guard_band_planes[plane].normal) > 0))
+            outcode |= OUTCODE(NUM_PLANES + plane);
+
+    return outcode;
+}
+
+// Planos contra los que hay que recortar un triángulo dada la OR de los outcodes de sus
+// vértices (0 si se puede rasterizar tal cual). Solo hace falta recortar contra los planos
+// de los que algún vértice queda fuera, los puntos nuevos nunca salen de los demás
+int get_clip_planes(int outcode_or)
+{
+    int planes = outcode_or & FRUSTUM_OUTCODE_MASK;
+    if (is_guard_band && !(outcode_or & GUARD_BAND_OUTCODE_MASK))
+        planes &= OUTCODE(NEAR_FRUSTUM_PLANE) | OUTCODE(FAR_FRUSTUM_PLANE);
+    return planes;
+}
+
+// Una esfera (en espacio de cámara) queda fuera si está entera detrás de algún plano
+bool is_sphere_outside_frustum(vec3_t center, float radius)
+{
+    for (int plane = 0; plane < NUM_PLANES; plane++)
+    {
+        float distance = vec3_dot(vec3_sub(center, frustum_planes[plane].point), frustum_planes[plane].normal);
+        if (distance < -radius)
+            return true;
+    }
+    return false;
+}
+
+// Una caja (sus ocho esquinas en espacio de cámara) queda fuera si todas sus
+// esquinas están detrás del mismo plano, igual que el rechazo de triángulos
+bool is_box_outside_frustum(vec3_t corners[8])
+{
+    int outcode_and = FRUSTUM_OUTCODE_MASK;
+    for (int i = 0; i < 8 && outcode_and; i++)
+        outcode_and &= get_vertex_outcode(corners[i]);
+    return outcode_and != 0;
+}
+
+// Planos del frustum en espacio de mundo para una matriz de vista, como (normal, d)
+// Un punto de mundo p queda dentro si normal·p + d > 0, la distancia a un plano de
+// cámara n·(V*p - P) es lineal en p así que basta con pasar la normal por la vista
+void get_world_frustum_planes(mat4_t view_matrix, vec4_t planes[6])
+{
+    for (int plane = 0; plane < NUM_PLANES; plane++)
+    {
+        vec3_t n = frustum_planes[plane].normal;
+        float (*m)[4] = view_matrix.m;
+        planes[plane].x = n.x * m[0][0] + n.y * m[1][0] + n.z * m[2][0];
+        planes[plane].y = n.x * m[0][1] + n.y * m[1][1] + n.z * m[2][1];
+        planes[plane].z = n.x * m[0][2] + n.y * m[1][2] + n.z * m[2][2];
+        planes[plane].w = n.x * m[0][3] + n.y * m[1][3] + n.z * m[2][3] - vec3_dot(n, frustum_planes[plane].point);
+    }
+}
+
 void clip_polygon(polygon_t *polygon)
 {
-    clip_polygon_against_plane(polygon, LEFT_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, TOP_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, NEAR_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, FAR_FRUSTUM_PLANE);
+    clip_polygon_against_planes(polygon, FRUSTUM_OUTCODE_MASK);
+}
+
+void clip_polygon_against_planes(polygon_t *polygon, int planes)
+{
+    for (int plane = 0; plane < NUM_PLANES; plane++)
+        if (planes & OUTCODE(plane))
+            clip_polygon_against_plane(polygon, plane);
 }
\ No newline at end of file
@@ -1,12 +1,17 @@
 #ifndef CLIPPING_H
 #define CLIPPING_H
 
+#include <stdbool.h>
 #include "vector.h"
+#include "matrix.h"
 #include "triangle.h"
 
 #define MAX_NUM_POLY_VERTICES 10
 #define MAX_NUM_POLY_TRIANGLES 10
 
+// Píxeles que la guard band se extiende fuera de la pantalla por cada lado como máximo
+#define GUARD_BAND_PIXELS 256
+
 enum
 {
     LEFT_FRUSTUM_PLANE,
@@ -17,6 +22,13 @@ enum
     FAR_FRUSTUM_PLANE
 };
 
+// Outcodes: un bit por cada plano del que el vértice queda fuera, primero los seis
+// del frustum y después los cuatro laterales de la guard band (izquierda, derecha,
+// arriba y abajo en el mismo orden)
+#define OUTCODE(plane) (1 << (plane))
+#define FRUSTUM_OUTCODE_MASK 0x3F
+#define GUARD_BAND_OUTCODE_MASK 0x3C0
+
 typedef struct plane_t
 {
     vec3_t point;
@@ -31,8 +43,20 @@ typedef struct polygon_t
 } polygon_t;
 
 void init_frustum_planes(float fov_x, float fov_y, float z_near, float z_far);
+int get_guard_band_pixels(int width, int height);
+void init_guard_band_planes(float fov_x, float fov_y, float scale_x, float scale_y);
+void set_guard_band_clipping(bool enabled);
+bool is_guard_band_clipping(void);
 polygon_t polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2);
 void triangles_from_polygon(polygon_t *polygon, triangle_t triangles[], int *num_triangles);
+bool is_vertex_inside_plane(vec3_t vertex, int plane);
+bool is_vertex_inside_frustum(vec3_t vertex);
+int get_vertex_outcode(vec3_t vertex);
+int get_clip_planes(int outcode_or);
+bool is_sphere_outside_frustum(vec3_t center, float radius);
+bool is_box_outside_frustum(vec3_t corners[8]);
+void get_world_frustum_planes(mat4_t view_matrix, vec4_t planes[6]);
 void clip_polygon(polygon_t *polygon);
+void clip_polygon_against_planes(polygon_t *polygon, int planes);
 
 #endif
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "display.h"
+#include "hiz.h"
+#include "triangle.h"
 
 /////// Globales
 /////// Las variables estáticas son visibles solo en el fichero actual
@@ -8,11 +10,24 @@ static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
 static SDL_Texture *color_buffer_texture = NULL; // Para el color buffer
 static float *z_buffer = NULL;
+static uint32_t *visibility_buffer = NULL; // identificador del triángulo visible en cada píxel (0 = vacío)
 static bool is_fullscreen = false;
 static int window_width = 1000;
 static int window_height = 500;
 static int render_method = 0;
 static int cull_method = 0;
+static int raster_method = 0;
+static bool is_subpixel = true;
+static bool is_hiz = true;
+static bool is_visibility = false;
+
+// Rectángulo de recorte propio de cada hilo (el máximo no está incluido)
+// Cuando se renderiza por tiles cada hilo solo puede escribir dentro de su tile,
+// así los buffers de color y profundidad se comparten sin necesidad de bloqueos
+static __thread int clip_min_x = 0;
+static __thread int clip_min_y = 0;
+static __thread int clip_max_x = 0;
+static __thread int clip_max_y = 0;
 
 int get_window_width(void)
 {
@@ -32,10 +47,80 @@ void set_cull_method(int method)
 {
     cull_method = method;
 }
+void set_raster_method(int method)
+{
+    raster_method = method;
+}
+int get_raster_method(void)
+{
+    return raster_method;
+}
+void set_subpixel_precision(bool enabled)
+{
+    is_subpixel = enabled;
+}
+bool is_subpixel_precision(void)
+{
+    return is_subpixel;
+}
+void set_hiz_culling(bool enabled)
+{
+    is_hiz = enabled;
+}
+bool is_hiz_culling(void)
+{
+    return is_hiz;
+}
+void set_visibility_buffer_mode(bool enabled)
+{
+    is_visibility = enabled;
+}
+bool is_visibility_buffer_mode(void)
+{
+    return is_visibility;
+}
+
+// Recortamos el rectángulo contra la ventana para no salirnos nunca de los buffers
+void set_clip_rect(SDL_Rect rect)
+{
+    clip_min_x = rect.x < 0 ? 0 : rect.x;
+    clip_min_y = rect.y < 0 ? 0 : rect.y;
+    clip_max_x = rect.x + rect.w > window_width ? window_width : rect.x + rect.w;
+    clip_max_y = rect.y + rect.h > window_height ? window_height : rect.y + rect.h;
+}
+
+void reset_clip_rect(void)
+{
+    SDL_Rect window_rect = {0, 0, window_width, window_height};
+    set_clip_rect(window_rect);
+}
+
+SDL_Rect get_clip_rect(void)
+{
+    SDL_Rect rect = {clip_min_x, clip_min_y, clip_max_x - clip_min_x, clip_max_y - clip_min_y};
+    return rect;
+}
+
+// Acceso directo a los buffers para los kernels SIMD, que escriben varios píxeles a la vez
+// (quien los use es responsable de no salirse de su rectángulo de recorte)
+uint32_t *get_color_buffer(void)
+{
+    return color_buffer;
+}
+
+float *get_z_buffer(void)
+{
+    return z_buffer;
+}
+
+uint32_t *get_visibility_buffer(void)
+{
+    return visibility_buffer;
+}
 
 float get_zbuffer_at(int x, int y)
 {
-    if (x < 0 || x >= window_width - 1 || y < 0 || y > window_height - 1)
+    if (x < clip_min_x || x >= clip_max_x || y < clip_min_y || y >= clip_max_y)
     {
         return 1.0;
     }
@@ -43,7 +128,7 @@ float get_zbuffer_at(int x, int y)
 }
 void update_zbuffer_at(int x, int y, float value)
 {
-    if (x < 0 || x >= window_width - 1 || y < 0 || y > window_height - 1)
+    if (x < clip_min_x || x >= clip_max_x || y < clip_min_y || y >= clip_max_y)
     {
         return;
     }
@@ -69,8 +154,12 @@ bool initialize_window(void)
         int fullscreen_height = display_mode.h;
 
         // Simular resolución más pequeña
-        window_width = fullscreen_width / 2;
-        window_height = fullscreen_height / 2;
+        // El rasterizador trabaja en punto fijo de 32 bits, en pantallas muy grandes reducimos más
+        int divisor = 2;
+        while (fullscreen_width / divisor > MAX_RASTER_EXTENT || fullscreen_height / divisor > MAX_RASTER_EXTENT)
+            divisor++;
+        window_width = fullscreen_width / divisor;
+        window_height = fullscreen_height / divisor;
 
         // Crear ventana SDL
         window = SDL_CreateWindow(
@@ -109,9 +198,16 @@ bool initialize_window(void)
         return false;
     }
 
+    // Por defecto el hilo principal puede dibujar en toda la ventana
+    reset_clip_rect();
+
     // Asigno bytes requeridos en memoria para el color buffer y el z-buffer
     color_buffer = (uint32_t *)malloc(sizeof(uint32_t) * window_width * window_height);
     z_buffer = (float *)malloc(sizeof(float) * window_width * window_height);
+    visibility_buffer = (uint32_t *)malloc(sizeof(uint32_t) * window_width * window_height);
+
+    // Pirámide de profundidad con la profundidad mínima y máxima por bloque y por tile
+    init_hiz(window_width, window_height);
 
     // There is a possibility that malloc fails to allocate that number of bytes in memory maybe the
     // machine does not have enough free memory, if that happens malloc will return a NULL pointer.
@@ -139,24 +235,47 @@ void destroy_window(void)
 {
     free(color_buffer); // Si liberas algo que ya ha sido liberado da un error de memoria
     free(z_buffer);
+    free(visibility_buffer);
+    free_hiz();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
 
+// Los buffers se limpian solo dentro del rectángulo de recorte del hilo
 void clear_color_buffer(uint32_t color)
 {
-    for (int i = 0; i < window_height * window_width; i++)
+    for (int y = clip_min_y; y < clip_max_y; y++)
     {
-        color_buffer[i] = color;
+        for (int x = clip_min_x; x < clip_max_x; x++)
+        {
+            color_buffer[(window_width * y) + x] = color;
+        }
     }
 }
 
 void clear_z_buffer()
 {
-    for (int i = 0; i < window_height * window_width; i++)
+    for (int y = clip_min_y; y < clip_max_y; y++)
+    {
+        for (int x = clip_min_x; x < clip_max_x; x++)
+        {
+            z_buffer[(window_width * y) + x] = 1.0; // estandar de la industria, crece hacia adentro
+        }
+    }
+
+    // La pirámide de profundidad se limpia a la vez que el z-buffer
+    clear_hiz(get_clip_rect());
+}
+
+void clear_visibility_buffer(void)
+{
+    for (int y = clip_min_y; y < clip_max_y; y++)
     {
-        z_buffer[i] = 1.0; // estandar de la industria, crece hacia adentro
+        for (int x = clip_min_x; x < clip_max_x; x++)
+        {
+            visibility_buffer[(window_width * y) + x] = 0;
+        }
     }
 }
 
@@ -199,9 +318,12 @@ void draw_grid(void)
 {
     // Dibujar una cuadrícula que rellena el espacio
     // Las líneas deben concordar con las filas y columnas múltiples de 10
-    for (int y = 0; y < window_height; y += 10)
+    // Empezamos por el primer múltiplo de 10 dentro del rectángulo de recorte
+    int first_x = (clip_min_x + 9) / 10 * 10;
+    int first_y = (clip_min_y + 9) / 10 * 10;
+    for (int y = first_y; y < clip_max_y; y += 10)
     {
-        for (int x = 0; x < window_width; x += 10)
+        for (int x = first_x; x < clip_max_x; x += 10)
         {
             if (x != 0 && y != 0) // Esto esconde la primera fila y columna
                 color_buffer[(window_width * y) + x] = 0xFF444444;
@@ -211,12 +333,19 @@ void draw_grid(void)
 
 void draw_pixel(int x, int y, uint32_t color)
 {
-    // Dibujamos el píxel si está dentro de la ventana
-    if (x < 0 || x >= window_width || y < 0 || y >= window_height)
+    // Dibujamos el píxel si está dentro de la ventana (y del tile del hilo actual)
+    if (x < clip_min_x || x >= clip_max_x || y < clip_min_y || y >= clip_max_y)
         return;
     color_buffer[(window_width * y) + x] = color;
 }
 
+void draw_visibility_pixel(int x, int y, uint32_t triangle_id)
+{
+    if (x < clip_min_x || x >= clip_max_x || y < clip_min_y || y >= clip_max_y)
+        return;
+    visibility_buffer[(window_width * y) + x] = triangle_id;
+}
+
 // Algoritmo DDA: https://es.wikipedia.org/wiki/Analizador_diferencial_digital
 void draw_line(int x0, int y0, int x1, int y1, uint32_t color)
 {
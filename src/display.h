@@ -20,6 +20,13 @@ enum cull_method
     CULL_BACKFACE
 };
 
+enum raster_method
+{
+    RASTER_SCANLINE,
+    RASTER_EDGE,
+    RASTER_EDGE_SIMD
+};
+
 enum render_method
 {
     RENDER_WIRE,
@@ -30,10 +37,18 @@ enum render_method
     RENDER_TEXTURED_WIRE
 };
 
+void set_clip_rect(SDL_Rect rect);
+void reset_clip_rect(void);
+SDL_Rect get_clip_rect(void);
+
 void clear_color_buffer(uint32_t color);
 void render_color_buffer(void);
 void clear_z_buffer();
+void clear_visibility_buffer(void);
 float get_zbuffer_at(int x, int y);
+uint32_t *get_color_buffer(void);
+float *get_z_buffer(void);
+uint32_t *get_visibility_buffer(void);
 void update_zbuffer_at(int x, int y, float value);
 
 bool initialize_window(void);
@@ -41,6 +56,7 @@ void destroy_window(void);
 
 void draw_grid(void);
 void draw_pixel(int x, int y, uint32_t color);
+void draw_visibility_pixel(int x, int y, uint32_t triangle_id);
 void draw_rect(int x, int y, int width, int height, uint32_t color);
 void draw_line(int x0, int y0, int x1, int y1, uint32_t color);
 
@@ -49,6 +65,14 @@ int get_window_height(void);
 bool is_cull_backface(void);
 void set_render_method(int method);
 void set_cull_method(int method);
+void set_raster_method(int method);
+int get_raster_method(void);
+void set_subpixel_precision(bool enabled);
+bool is_subpixel_precision(void);
+void set_hiz_culling(bool enabled);
+bool is_hiz_culling(void);
+void set_visibility_buffer_mode(bool enabled);
+bool is_visibility_buffer_mode(void);
 bool should_render_filled_triangle(void);
 bool should_render_textured_triangle(void);
 bool should_render_wireframe(void);
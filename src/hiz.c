@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include "hiz.h"
+#include "display.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Hierarchical Z (depth pyramid)
+///////////////////////////////////////////////////////////////////////////////
+// Versión reducida del z-buffer que guarda, para cada bloque de 8x8 y cada
+// tile de 64x64, la profundidad más lejana (max) de sus píxeles y, por tile,
+// también la más cercana (min). El rasterizador las usa para descartar
+// triángulos y bloques que quedan detrás de todo lo ya dibujado sin mirar el
+// z-buffer píxel a píxel.
+//
+// Los valores son conservadores: el max nunca es menor que el z-buffer real
+// (se baja cuando un triángulo cubre el bloque entero o se recalcula leyendo
+// el bloque del z-buffer) y el min nunca es mayor (se baja con la profundidad
+// más cercana de cada triángulo dibujado)
+///////////////////////////////////////////////////////////////////////////////
+#define BLOCKS_PER_TILE (HIZ_TILE_SIZE / HIZ_BLOCK_SIZE)
+
+static float *block_max = NULL;
+static float *tile_max = NULL;
+static float *tile_min = NULL;
+static int num_blocks_x = 0;
+static int num_blocks_y = 0;
+static int num_tiles_x = 0;
+static int num_tiles_y = 0;
+static int hiz_width = 0;
+static int hiz_height = 0;
+
+void init_hiz(int width, int height)
+{
+    num_blocks_x = (width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+    num_blocks_y = (height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+    num_tiles_x = (width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+    num_tiles_y = (height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+    hiz_width = width;
+    hiz_height = height;
+
+    // Empezamos con todo a 1.0, igual que un z-buffer recién limpiado
+    block_max = (float *)malloc(sizeof(float) * num_blocks_x * num_blocks_y);
+    tile_max = (float *)malloc(sizeof(float) * num_tiles_x * num_tiles_y);
+    tile_min = (float *)malloc(sizeof(float) * num_tiles_x * num_tiles_y);
+    for (int i = 0; i < num_blocks_x * num_blocks_y; i++)
+        block_max[i] = 1.0;
+    for (int i = 0; i < num_tiles_x * num_tiles_y; i++)
+    {
+        tile_max[i] = 1.0;
+        tile_min[i] = 1.0;
+    }
+
+    SDL_Rect screen = {0, 0, width, height};
+    clear_hiz(screen);
+}
+
+// Se llama al limpiar el z-buffer dentro del rectángulo (todo vuelve a 1.0)
+void clear_hiz(SDL_Rect rect)
+{
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+
+    // Cualquier bloque o tile que toque el rectángulo puede tener ahora píxeles a 1.0,
+    // el máximo posible, así que su max pasa a 1.0
+    for (int by = rect.y / HIZ_BLOCK_SIZE; by <= (rect.y + rect.h - 1) / HIZ_BLOCK_SIZE; by++)
+        for (int bx = rect.x / HIZ_BLOCK_SIZE; bx <= (rect.x + rect.w - 1) / HIZ_BLOCK_SIZE; bx++)
+            block_max[(num_blocks_x * by) + bx] = 1.0;
+
+    for (int ty = rect.y / HIZ_TILE_SIZE; ty <= (rect.y + rect.h - 1) / HIZ_TILE_SIZE; ty++)
+    {
+        for (int tx = rect.x / HIZ_TILE_SIZE; tx <= (rect.x + rect.w - 1) / HIZ_TILE_SIZE; tx++)
+        {
+            tile_max[(num_tiles_x * ty) + tx] = 1.0;
+
+            // El min solo se puede subir si el tile entero se ha limpiado,
+            // si no los píxeles que quedan fuera aún pueden estar más cerca.
+            // Los tiles del borde derecho e inferior solo cuentan sus píxeles dentro de la ventana
+            SDL_Rect tile = {tx * HIZ_TILE_SIZE, ty * HIZ_TILE_SIZE, HIZ_TILE_SIZE, HIZ_TILE_SIZE};
+            tile.w = tile.x + tile.w > hiz_width ? hiz_width - tile.x : tile.w;
+            tile.h = tile.y + tile.h > hiz_height ? hiz_height - tile.y : tile.h;
+            SDL_Rect cleared;
+            if (SDL_IntersectRect(&rect, &tile, &cleared) && cleared.w == tile.w && cleared.h == tile.h)
+                tile_min[(num_tiles_x * ty) + tx] = 1.0;
+        }
+    }
+}
+
+// Profundidad más lejana guardada en el bloque que contiene el píxel (x,y)
+float get_hiz_block_max(int x, int y)
+{
+    return block_max[(num_blocks_x * (y / HIZ_BLOCK_SIZE)) + (x / HIZ_BLOCK_SIZE)];
+}
+
+// Un triángulo ha cubierto el bloque entero y nada en él queda más lejos que depth
+void lower_hiz_block_max(int x, int y, float depth)
+{
+    int bx = x / HIZ_BLOCK_SIZE;
+    int by = y / HIZ_BLOCK_SIZE;
+    float *block = &block_max[(num_blocks_x * by) + bx];
+    if (depth >= *block)
+        return;
+
+    float previous = *block;
+    *block = depth;
+
+    // El max del tile solo cambia si este bloque era el que lo fijaba
+    int tx = bx / BLOCKS_PER_TILE;
+    int ty = by / BLOCKS_PER_TILE;
+    float *tile = &tile_max[(num_tiles_x * ty) + tx];
+    if (previous < *tile)
+        return;
+
+    float farthest = 0;
+    for (int j = ty * BLOCKS_PER_TILE; j < (ty + 1) * BLOCKS_PER_TILE && j < num_blocks_y; j++)
+        for (int i = tx * BLOCKS_PER_TILE; i < (tx + 1) * BLOCKS_PER_TILE && i < num_blocks_x; i++)
+            if (block_max[(num_blocks_x * j) + i] > farthest)
+                farthest = block_max[(num_blocks_x * j) + i];
+    *tile = farthest;
+}
+
+// Recalcula el max exacto del bloque leyendo sus píxeles del z-buffer
+// (quien llama debe ser el dueño del bloque entero, es decir, estar dentro de su tile)
+void refresh_hiz_block_max(int x, int y)
+{
+    int block_x = x - (x % HIZ_BLOCK_SIZE);
+    int block_y = y - (y % HIZ_BLOCK_SIZE);
+    int end_x = block_x + HIZ_BLOCK_SIZE < get_window_width() ? block_x + HIZ_BLOCK_SIZE : get_window_width();
+    int end_y = block_y + HIZ_BLOCK_SIZE < get_window_height() ? block_y + HIZ_BLOCK_SIZE : get_window_height();
+
+    float *z_buffer = get_z_buffer();
+    float farthest = 0;
+    for (int j = block_y; j < end_y; j++)
+        for (int i = block_x; i < end_x; i++)
+            if (z_buffer[(get_window_width() * j) + i] > farthest)
+                farthest = z_buffer[(get_window_width() * j) + i];
+
+    lower_hiz_block_max(block_x, block_y, farthest);
+}
+
+// Profundidad más lejana de los tiles que tocan el rectángulo (extremos incluidos)
+float get_hiz_max(int min_x, int min_y, int max_x, int max_y)
+{
+    float farthest = 0;
+    for (int ty = min_y / HIZ_TILE_SIZE; ty <= max_y / HIZ_TILE_SIZE; ty++)
+        for (int tx = min_x / HIZ_TILE_SIZE; tx <= max_x / HIZ_TILE_SIZE; tx++)
+            if (tile_max[(num_tiles_x * ty) + tx] > farthest)
+                farthest = tile_max[(num_tiles_x * ty) + tx];
+    return farthest;
+}
+
+// Profundidad más cercana de los tiles que tocan el rectángulo (extremos incluidos)
+float get_hiz_min(int min_x, int min_y, int max_x, int max_y)
+{
+    float nearest = 1.0;
+    for (int ty = min_y / HIZ_TILE_SIZE; ty <= max_y / HIZ_TILE_SIZE; ty++)
+        for (int tx = min_x / HIZ_TILE_SIZE; tx <= max_x / HIZ_TILE_SIZE; tx++)
+            if (tile_min[(num_tiles_x * ty) + tx] < nearest)
+                nearest = tile_min[(num_tiles_x * ty) + tx];
+    return nearest;
+}
+
+// Se ha dibujado algo dentro del rectángulo que puede estar tan cerca como depth
+void lower_hiz_min(int min_x, int min_y, int max_x, int max_y, float depth)
+{
+    for (int ty = min_y / HIZ_TILE_SIZE; ty <= max_y / HIZ_TILE_SIZE; ty++)
+        for (int tx = min_x / HIZ_TILE_SIZE; tx <= max_x / HIZ_TILE_SIZE; tx++)
+            if (depth < tile_min[(num_tiles_x * ty) + tx])
+                tile_min[(num_tiles_x * ty) + tx] = depth;
+}
+
+void free_hiz(void)
+{
+    free(block_max);
+    free(tile_max);
+    free(tile_min);
+}
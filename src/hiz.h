@@ -0,0 +1,25 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <SDL2/SDL.h>
+
+// Niveles de la pirámide de profundidad, en píxeles
+// Los bloques coinciden con los del rasterizador de aristas y los tiles con los
+// del render en paralelo, así cada hilo solo toca las entradas de su tile
+#define HIZ_BLOCK_SIZE 8
+#define HIZ_TILE_SIZE 64
+
+// Margen para que los errores de redondeo de la interpolación nunca descarten de más
+#define HIZ_EPSILON 0.00001f
+
+void init_hiz(int width, int height);
+void clear_hiz(SDL_Rect rect);
+float get_hiz_block_max(int x, int y);
+void lower_hiz_block_max(int x, int y, float depth);
+void refresh_hiz_block_max(int x, int y);
+float get_hiz_max(int min_x, int min_y, int max_x, int max_y);
+float get_hiz_min(int min_x, int min_y, int max_x, int max_y);
+void lower_hiz_min(int min_x, int min_y, int max_x, int max_y, float depth);
+void free_hiz(void);
+
+#endif
@@ -0,0 +1,582 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "lod.h"
+#include "array.h"
+#include "display.h"
+#include "transform.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Level of detail chain built with quadric error metrics (Garland-Heckbert)
+///////////////////////////////////////////////////////////////////////////////
+// Cada vértice acumula una cuádrica con los planos de sus caras, que mide la
+// suma de distancias al cuadrado a esos planos. Colapsar una arista suma las
+// dos cuádricas y el coste es el error de la cuádrica en la posición final.
+// Vamos colapsando siempre la arista más barata (un montículo con entradas
+// obsoletas que se descartan al salir) hasta quedarnos con las caras pedidas.
+//
+// Los colapsos son de media arista: el vértice que desaparece se mueve sobre
+// el que queda, así los niveles solo usan posiciones de la malla original y
+// las cajas de la original siguen envolviendo a todos (el culling no cambia).
+// Las coordenadas de textura van por esquina de cara, un colapso solo se
+// acepta si cada cara que sobrevive puede heredar la del vértice que queda
+// en su misma isla de la textura (así no se rompen las costuras), y se
+// rechazan los que dan la vuelta a alguna cara
+///////////////////////////////////////////////////////////////////////////////
+
+// Peso de los planos que conservan los bordes abiertos de la malla
+#define LOD_BOUNDARY_WEIGHT 100.0
+
+static bool is_lod_enabled = true;
+static bool use_hysteresis = true;
+
+typedef struct quadric_t
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} quadric_t;
+
+typedef struct collapse_t
+{
+    double cost;
+    int from;         // vértice que desaparece
+    int to;           // vértice que queda
+    int from_version; // versiones de los vértices al calcular el coste
+    int to_version;
+} collapse_t;
+
+typedef struct simplify_vertex_t
+{
+    quadric_t quadric;
+    int *faces; // caras que lo usan (array dinámico, puede tener caras ya eliminadas)
+    int version;
+    bool is_alive;
+} simplify_vertex_t;
+
+typedef struct simplifier_t
+{
+    vec3_t *positions;
+    simplify_vertex_t *vertices;
+    face_t *faces;
+    bool *is_face_alive;
+    int num_live_faces;
+    collapse_t *heap; // montículo de mínimos por coste
+    int heap_count;
+    int heap_capacity;
+} simplifier_t;
+
+typedef struct boundary_edge_t
+{
+    uint64_t key;
+    int face;
+    int corner;
+} boundary_edge_t;
+
+void set_lod_selection(bool enabled)
+{
+    is_lod_enabled = enabled;
+}
+
+bool is_lod_selection(void)
+{
+    return is_lod_enabled;
+}
+
+void set_lod_hysteresis(bool enabled)
+{
+    use_hysteresis = enabled;
+}
+
+bool is_lod_hysteresis(void)
+{
+    return use_hysteresis;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Quadrics
+///////////////////////////////////////////////////////////////////////////////
+static void add_plane_quadric(quadric_t *q, double a, double b, double c, double d, double weight)
+{
+    q->a2 += weight * a * a;
+    q->ab += weight * a * b;
+    q->ac += weight * a * c;
+    q->ad += weight * a * d;
+    q->b2 += weight * b * b;
+    q->bc += weight * b * c;
+    q->bd += weight * b * d;
+    q->c2 += weight * c * c;
+    q->cd += weight * c * d;
+    q->d2 += weight * d * d;
+}
+
+static quadric_t sum_quadrics(quadric_t *q, quadric_t *r)
+{
+    quadric_t sum = {
+        q->a2 + r->a2, q->ab + r->ab, q->ac + r->ac, q->ad + r->ad, q->b2 + r->b2,
+        q->bc + r->bc, q->bd + r->bd, q->c2 + r->c2, q->cd + r->cd, q->d2 + r->d2};
+    return sum;
+}
+
+static double quadric_error(quadric_t *q, vec3_t v)
+{
+    double x = v.x, y = v.y, z = v.z;
+    return q->a2 * x * x + 2 * q->ab * x * y + 2 * q->ac * x * z + 2 * q->ad * x +
+           q->b2 * y * y + 2 * q->bc * y * z + 2 * q->bd * y +
+           q->c2 * z * z + 2 * q->cd * z +
+           q->d2;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Face corners
+///////////////////////////////////////////////////////////////////////////////
+static int *get_corner_index(face_t *face, int corner)
+{
+    return corner == 0 ? &face->a : (corner == 1 ? &face->b : &face->c);
+}
+
+static tex2_t *get_corner_uv(face_t *face, int corner)
+{
+    return corner == 0 ? &face->a_uv : (corner == 1 ? &face->b_uv : &face->c_uv);
+}
+
+static int find_corner(face_t *face, int vertex)
+{
+    return face->a == vertex ? 0 : (face->b == vertex ? 1 : (face->c == vertex ? 2 : -1));
+}
+
+static vec3_t get_face_normal(vec3_t a, vec3_t b, vec3_t c)
+{
+    return vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary min-heap of collapses
+///////////////////////////////////////////////////////////////////////////////
+static void push_collapse(simplifier_t *s, int from, int to)
+{
+    simplify_vertex_t *v_from = &s->vertices[from];
+    simplify_vertex_t *v_to = &s->vertices[to];
+    quadric_t quadric = sum_quadrics(&v_from->quadric, &v_to->quadric);
+
+    collapse_t collapse = {
+        .cost = quadric_error(&quadric, s->positions[to]),
+        .from = from,
+        .to = to,
+        .from_version = v_from->version,
+        .to_version = v_to->version,
+    };
+    if (s->heap_count == s->heap_capacity)
+    {
+        s->heap_capacity = s->heap_capacity ? s->heap_capacity * 2 : 1024;
+        s->heap = (collapse_t *)realloc(s->heap, sizeof(collapse_t) * s->heap_capacity);
+    }
+    s->heap[s->heap_count] = collapse;
+
+    // Subimos la nueva entrada hasta su sitio
+    int i = s->heap_count++;
+    while (i > 0 && s->heap[(i - 1) / 2].cost > s->heap[i].cost)
+    {
+        collapse_t swap = s->heap[i];
+        s->heap[i] = s->heap[(i - 1) / 2];
+        s->heap[(i - 1) / 2] = swap;
+        i = (i - 1) / 2;
+    }
+}
+
+static collapse_t pop_collapse(simplifier_t *s)
+{
+    collapse_t top = s->heap[0];
+    int count = --s->heap_count;
+    s->heap[0] = s->heap[count];
+
+    // Bajamos la última entrada desde la raíz hasta su sitio
+    int i = 0;
+    while (true)
+    {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < count && s->heap[left].cost < s->heap[smallest].cost)
+            smallest = left;
+        if (right < count && s->heap[right].cost < s->heap[smallest].cost)
+            smallest = right;
+        if (smallest == i)
+            break;
+        collapse_t swap = s->heap[i];
+        s->heap[i] = s->heap[smallest];
+        s->heap[smallest] = swap;
+        i = smallest;
+    }
+    return top;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Edge collapses
+///////////////////////////////////////////////////////////////////////////////
+// Busca en las caras que se eliminan (las que tienen from y to) una de la misma
+// isla de textura que 'from_uv' y devuelve la coordenada de 'to' en ella
+static bool find_collapsed_uv(simplifier_t *s, int from, int to, tex2_t from_uv, tex2_t *to_uv)
+{
+    int *faces = s->vertices[from].faces;
+    for (int i = 0; i < array_length(faces); i++)
+    {
+        face_t *face = &s->faces[faces[i]];
+        if (!s->is_face_alive[faces[i]] || find_corner(face, to) < 0)
+            continue;
+
+        tex2_t *uv = get_corner_uv(face, find_corner(face, from));
+        if (uv->u == from_uv.u && uv->v == from_uv.v)
+        {
+            *to_uv = *get_corner_uv(face, find_corner(face, to));
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is_collapse_valid(simplifier_t *s, int from, int to)
+{
+    bool has_shared_face = false;
+    int *faces = s->vertices[from].faces;
+    for (int i = 0; i < array_length(faces); i++)
+    {
+        if (!s->is_face_alive[faces[i]])
+            continue;
+        face_t *face = &s->faces[faces[i]];
+        if (find_corner(face, to) >= 0)
+        {
+            has_shared_face = true;
+            continue;
+        }
+
+        // La cara no puede darse la vuelta ni quedarse sin área al mover el vértice
+        int corner = find_corner(face, from);
+        vec3_t points[3] = {s->positions[face->a], s->positions[face->b], s->positions[face->c]};
+        vec3_t old_normal = get_face_normal(points[0], points[1], points[2]);
+        points[corner] = s->positions[to];
+        vec3_t new_normal = get_face_normal(points[0], points[1], points[2]);
+        if (vec3_dot(old_normal, new_normal) <= 0)
+            return false;
+
+        // Tiene que poder heredar la coordenada de textura de 'to' de su misma isla
+        tex2_t to_uv;
+        if (!find_collapsed_uv(s, from, to, *get_corner_uv(face, corner), &to_uv))
+            return false;
+    }
+    return has_shared_face;
+}
+
+static void apply_collapse(simplifier_t *s, int from, int to)
+{
+    simplify_vertex_t *v_from = &s->vertices[from];
+    simplify_vertex_t *v_to = &s->vertices[to];
+
+    // Primero calculamos las coordenadas heredadas, antes de eliminar ninguna cara
+    int num_faces = array_length(v_from->faces);
+    tex2_t *new_uvs = (tex2_t *)malloc(sizeof(tex2_t) * (num_faces + 1));
+    for (int i = 0; i < num_faces; i++)
+    {
+        face_t *face = &s->faces[v_from->faces[i]];
+        if (s->is_face_alive[v_from->faces[i]] && find_corner(face, to) < 0)
+            find_collapsed_uv(s, from, to, *get_corner_uv(face, find_corner(face, from)), &new_uvs[i]);
+    }
+
+    for (int i = 0; i < num_faces; i++)
+    {
+        int face_index = v_from->faces[i];
+        if (!s->is_face_alive[face_index])
+            continue;
+
+        face_t *face = &s->faces[face_index];
+        if (find_corner(face, to) >= 0)
+        {
+            // Las caras de la arista desaparecen
+            s->is_face_alive[face_index] = false;
+            s->num_live_faces--;
+            continue;
+        }
+
+        int corner = find_corner(face, from);
+        *get_corner_index(face, corner) = to;
+        *get_corner_uv(face, corner) = new_uvs[i];
+        array_push(v_to->faces, face_index);
+    }
+    free(new_uvs);
+
+    v_to->quadric = sum_quadrics(&v_to->quadric, &v_from->quadric);
+    v_to->version++;
+    v_from->is_alive = false;
+
+    // Compactamos las caras de 'to' y volvemos a calcular sus aristas
+    int *live_faces = NULL;
+    for (int i = 0; i < array_length(v_to->faces); i++)
+        if (s->is_face_alive[v_to->faces[i]])
+            array_push(live_faces, v_to->faces[i]);
+    array_free(v_to->faces);
+    v_to->faces = live_faces;
+
+    for (int i = 0; i < array_length(v_to->faces); i++)
+    {
+        face_t *face = &s->faces[v_to->faces[i]];
+        int corners[3] = {face->a, face->b, face->c};
+        for (int j = 0; j < 3; j++)
+        {
+            if (corners[j] == to)
+                continue;
+            push_collapse(s, corners[j], to);
+            push_collapse(s, to, corners[j]);
+        }
+    }
+}
+
+static int compare_boundary_edges(const void *a, const void *b)
+{
+    uint64_t key_a = ((const boundary_edge_t *)a)->key;
+    uint64_t key_b = ((const boundary_edge_t *)b)->key;
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Initial quadrics: face planes weighted by area plus the open borders
+///////////////////////////////////////////////////////////////////////////////
+static void init_quadrics(simplifier_t *s, int num_faces)
+{
+    for (int f = 0; f < num_faces; f++)
+    {
+        face_t *face = &s->faces[f];
+        vec3_t normal = get_face_normal(s->positions[face->a], s->positions[face->b], s->positions[face->c]);
+        float length = vec3_length(normal);
+        if (length == 0)
+            continue;
+        vec3_t n = vec3_div(normal, length);
+        double d = -vec3_dot(n, s->positions[face->a]);
+        int corners[3] = {face->a, face->b, face->c};
+        for (int j = 0; j < 3; j++)
+            add_plane_quadric(&s->vertices[corners[j]].quadric, n.x, n.y, n.z, d, length * 0.5);
+    }
+
+    // Las aristas que solo usa una cara son bordes, les añadimos un plano perpendicular
+    // a la cara con mucho peso para que el borde no se encoja
+    boundary_edge_t *edges = (boundary_edge_t *)malloc(sizeof(boundary_edge_t) * num_faces * 3 + 1);
+    for (int f = 0; f < num_faces; f++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            uint64_t a = *get_corner_index(&s->faces[f], j);
+            uint64_t b = *get_corner_index(&s->faces[f], (j + 1) % 3);
+            edges[f * 3 + j].key = a < b ? (a << 32) | b : (b << 32) | a;
+            edges[f * 3 + j].face = f;
+            edges[f * 3 + j].corner = j;
+        }
+    }
+    qsort(edges, num_faces * 3, sizeof(boundary_edge_t), compare_boundary_edges);
+
+    for (int i = 0; i < num_faces * 3;)
+    {
+        int run = 1;
+        while (i + run < num_faces * 3 && edges[i + run].key == edges[i].key)
+            run++;
+
+        if (run == 1)
+        {
+            face_t *face = &s->faces[edges[i].face];
+            int a = *get_corner_index(face, edges[i].corner);
+            int b = *get_corner_index(face, (edges[i].corner + 1) % 3);
+            vec3_t normal = get_face_normal(s->positions[face->a], s->positions[face->b], s->positions[face->c]);
+            vec3_t edge = vec3_sub(s->positions[b], s->positions[a]);
+            vec3_t border_normal = vec3_cross(edge, normal);
+            float length = vec3_length(border_normal);
+            if (length > 0)
+            {
+                vec3_t n = vec3_div(border_normal, length);
+                double d = -vec3_dot(n, s->positions[a]);
+                double weight = LOD_BOUNDARY_WEIGHT * vec3_dot(edge, edge);
+                add_plane_quadric(&s->vertices[a].quadric, n.x, n.y, n.z, d, weight);
+                add_plane_quadric(&s->vertices[b].quadric, n.x, n.y, n.z, d, weight);
+            }
+        }
+        i += run;
+    }
+    free(edges);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Simplify a geometry down to (about) the given number of faces
+///////////////////////////////////////////////////////////////////////////////
+static mesh_geometry_t *simplify_geometry(mesh_geometry_t *source, int target_faces)
+{
+    int num_vertices = array_length(source->vertices);
+    int num_faces = array_length(source->faces);
+
+    simplifier_t s = {
+        .positions = source->vertices,
+        .vertices = (simplify_vertex_t *)calloc(num_vertices + 1, sizeof(simplify_vertex_t)),
+        .faces = (face_t *)malloc(sizeof(face_t) * (num_faces + 1)),
+        .is_face_alive = (bool *)malloc(sizeof(bool) * (num_faces + 1)),
+        .num_live_faces = num_faces,
+        .heap = NULL,
+        .heap_count = 0,
+        .heap_capacity = 0,
+    };
+
+    for (int f = 0; f < num_faces; f++)
+    {
+        s.faces[f] = source->faces[f];
+        s.is_face_alive[f] = true;
+        array_push(s.vertices[s.faces[f].a].faces, f);
+        array_push(s.vertices[s.faces[f].b].faces, f);
+        array_push(s.vertices[s.faces[f].c].faces, f);
+    }
+    for (int v = 0; v < num_vertices; v++)
+        s.vertices[v].is_alive = true;
+
+    init_quadrics(&s, num_faces);
+
+    // Cada arista en los dos sentidos, al salir del montículo se comprueba si sigue valiendo
+    for (int f = 0; f < num_faces; f++)
+    {
+        int corners[3] = {s.faces[f].a, s.faces[f].b, s.faces[f].c};
+        for (int j = 0; j < 3; j++)
+        {
+            push_collapse(&s, corners[j], corners[(j + 1) % 3]);
+            push_collapse(&s, corners[(j + 1) % 3], corners[j]);
+        }
+    }
+
+    while (s.num_live_faces > target_faces && s.heap_count > 0)
+    {
+        collapse_t collapse = pop_collapse(&s);
+        simplify_vertex_t *v_from = &s.vertices[collapse.from];
+        simplify_vertex_t *v_to = &s.vertices[collapse.to];
+
+        // Entradas obsoletas: algún vértice ya no existe o ha cambiado su cuádrica
+        if (!v_from->is_alive || !v_to->is_alive ||
+            v_from->version != collapse.from_version || v_to->version != collapse.to_version)
+            continue;
+
+        if (is_collapse_valid(&s, collapse.from, collapse.to))
+            apply_collapse(&s, collapse.from, collapse.to);
+    }
+
+    // Compactamos los vértices que siguen en uso y las caras que quedan
+    mesh_geometry_t *level = (mesh_geometry_t *)calloc(1, sizeof(mesh_geometry_t));
+    level->id = source->id;
+    int *remap = (int *)malloc(sizeof(int) * (num_vertices + 1));
+    for (int v = 0; v < num_vertices; v++)
+        remap[v] = -1;
+
+    for (int f = 0; f < num_faces; f++)
+    {
+        if (!s.is_face_alive[f])
+            continue;
+        face_t face = s.faces[f];
+        int *indices[3] = {&face.a, &face.b, &face.c};
+        for (int j = 0; j < 3; j++)
+        {
+            if (remap[*indices[j]] < 0)
+            {
+                remap[*indices[j]] = array_length(level->vertices);
+                array_push(level->vertices, source->vertices[*indices[j]]);
+            }
+            *indices[j] = remap[*indices[j]];
+        }
+        array_push(level->faces, face);
+    }
+
+    load_mesh_bounds(level);
+    if (source->positions_x != NULL)
+        load_mesh_soa_positions(level);
+
+    for (int v = 0; v < num_vertices; v++)
+        array_free(s.vertices[v].faces);
+    free(s.vertices);
+    free(s.faces);
+    free(s.is_face_alive);
+    free(s.heap);
+    free(remap);
+
+    return level;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Build the LOD chain of a geometry, each level from the previous one
+///////////////////////////////////////////////////////////////////////////////
+void build_mesh_lods(mesh_geometry_t *geometry)
+{
+    geometry->lods[0] = geometry;
+    geometry->num_lods = 1;
+
+    while (geometry->num_lods < MAX_LOD_LEVELS)
+    {
+        mesh_geometry_t *previous = geometry->lods[geometry->num_lods - 1];
+        int previous_faces = array_length(previous->faces);
+        if (previous_faces <= LOD_MIN_FACES)
+            break;
+
+        mesh_geometry_t *level = simplify_geometry(previous, previous_faces / LOD_REDUCTION);
+
+        // Si las costuras o los bordes no dejan simplificar más no merece la pena otro nivel
+        if (array_length(level->faces) > previous_faces * 3 / 4)
+        {
+            level->num_lods = 1;
+            level->lods[0] = level;
+            free_mesh_geometry(level);
+            break;
+        }
+        geometry->lods[geometry->num_lods++] = level;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pick a level from the size of the bounding sphere on the screen
+///////////////////////////////////////////////////////////////////////////////
+// El nivel elegido es el más detallado cuyas caras caben en el área que cubre
+// la esfera en pantalla (a LOD_PIXELS_PER_FACE píxeles por cara). Con histéresis
+// solo se baja de detalle si tampoco caben con un área un poco mayor y solo se
+// sube si caben con un área un poco menor, así no se alterna cada frame en el
+// límite entre dos niveles
+///////////////////////////////////////////////////////////////////////////////
+static int get_lod_for_budget(mesh_geometry_t *geometry, float face_budget)
+{
+    for (int i = 0; i < geometry->num_lods; i++)
+        if (array_length(geometry->lods[i]->faces) <= face_budget)
+            return i;
+    return geometry->num_lods - 1;
+}
+
+mesh_geometry_t *select_mesh_lod(mesh_t *mesh)
+{
+    mesh_geometry_t *geometry = mesh->geometry;
+    vec4_t center = mat4_mul_vec4(get_view_matrix(), vec4_from_vec3(mesh->world_bounds_center));
+    float radius = mesh->world_bounds_radius;
+
+    // Sin niveles, o con la cámara dentro de la esfera, siempre el nivel completo
+    if (!is_lod_enabled || geometry->num_lods <= 1 || center.z <= radius)
+    {
+        mesh->lod = 0;
+        return geometry;
+    }
+
+    mat4_t proj_matrix = get_projection_matrix();
+    float pixel_radius = radius * proj_matrix.m[1][1] * (get_window_height() / 2.0) / center.z;
+    float face_budget = M_PI * pixel_radius * pixel_radius / LOD_PIXELS_PER_FACE;
+
+    if (!use_hysteresis)
+        mesh->lod = get_lod_for_budget(geometry, face_budget);
+    else
+    {
+        // Con más presupuesto sale el nivel más fino que aceptamos y con menos el más grueso,
+        // mientras el nivel actual quede entre los dos no cambia
+        int finest = get_lod_for_budget(geometry, face_budget * (1 + LOD_HYSTERESIS));
+        int coarsest = get_lod_for_budget(geometry, face_budget * (1 - LOD_HYSTERESIS));
+        if (mesh->lod < finest)
+            mesh->lod = finest;
+        else if (mesh->lod > coarsest)
+            mesh->lod = coarsest;
+    }
+
+    // Por si la geometría de la instancia ha cambiado
+    if (mesh->lod >= geometry->num_lods)
+        mesh->lod = geometry->num_lods - 1;
+
+    return geometry->lods[mesh->lod];
+}
@@ -0,0 +1,26 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stdbool.h>
+#include "mesh.h"
+
+// Cada nivel se simplifica hasta una cuarta parte de las caras del anterior
+#define LOD_REDUCTION 4
+
+// Solo se genera otro nivel si el anterior tiene más caras que esto
+#define LOD_MIN_FACES 512
+
+// Píxeles de pantalla que queremos que cubra cada cara como mínimo
+#define LOD_PIXELS_PER_FACE 4.0
+
+// Margen relativo del tamaño en pantalla para cambiar de nivel con histéresis
+#define LOD_HYSTERESIS 0.2
+
+void build_mesh_lods(mesh_geometry_t *geometry);
+mesh_geometry_t *select_mesh_lod(mesh_t *mesh);
+void set_lod_selection(bool enabled);
+bool is_lod_selection(void);
+void set_lod_hysteresis(bool enabled);
+bool is_lod_hysteresis(void);
+
+#endif
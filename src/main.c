@@ -14,6 +14,17 @@
 #include "triangle.h"
 #include "texture.h"
 #include "mesh.h"
+#include "transform.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "pipeline.h"
+#include "tile.h"
+#include "stats.h"
+#include "occlusion.h"
+#include "bvh.h"
+#include "asset_cache.h"
+#include "asset_loader.h"
+#include "lod.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables for execution status and game loop
@@ -22,28 +33,50 @@ bool is_running = false;
 int previous_frame_time = 0;
 float delta_time = 0;
 
-///////////////////////////////////////////////////////////////////////////////
-// Array to store triangles that should be rendered each frame
-///////////////////////////////////////////////////////////////////////////////
-#define MAX_TRIANGLES 10000
-triangle_t triangles_to_render[MAX_TRIANGLES];
-int num_triangles_to_render = 0;
+// Número de hilos para el pipeline, 0 para usar todos los núcleos disponibles
+// (se puede cambiar al compilar, por ejemplo con -DNUM_THREADS=4)
+#ifndef NUM_THREADS
+#define NUM_THREADS 0
+#endif
 
-///////////////////////////////////////////////////////////////////////////////
-// Declaration of our global transformation matrices
-///////////////////////////////////////////////////////////////////////////////
-mat4_t proj_matrix;
-mat4_t world_matrix;
-mat4_t view_matrix;
+// Rasterizado por tiles en paralelo (sort-middle) o serie sobre toda la pantalla
+bool is_tiled_rendering = true;
+
+// Píxeles extra alrededor de cada triángulo al repartirlo en tiles (marcas de los vértices)
+#define TILE_MARGIN 4
+
+// Ordenar los triángulos de delante hacia atrás antes de rasterizarlos
+bool is_sorting_triangles = true;
+
+// Mostrar por consola las estadísticas del frame una vez por segundo
+bool is_printing_stats = false;
+int stats_frame_count = 0;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Setup function to initialize variables and game objects
 ///////////////////////////////////////////////////////////////////////////////
 void setup(void)
 {
+    // Detectamos las instrucciones SIMD disponibles (SSE2/AVX2)
+    init_simd();
+
+    // Creamos los hilos de trabajo (0 = uno por núcleo de la CPU)
+    init_thread_pool(NUM_THREADS);
+
+    // Dividimos la pantalla en tiles para el rasterizado en paralelo
+    init_tiles(get_window_width(), get_window_height());
+
+    // Buffer de profundidad reducido donde se rasterizan los oclusores
+    init_occlusion(get_window_width(), get_window_height());
+
+    // Los OBJ y PNG se cargan en segundo plano, las mallas aparecen cuando están listas
+    init_asset_cache();
+    init_asset_loader();
+
     // Inicializamos el modo de renderizado y el culling
     set_render_method(RENDER_TEXTURED);
     set_cull_method(CULL_BACKFACE);
+    set_raster_method(RASTER_EDGE_SIMD);
 
     // Inicializar la dirección de luz de la escena
     init_light(vec3_new(0, 0, 1));
@@ -54,22 +87,32 @@ void setup(void)
     float fov_x = atan(tan(fov_y / 2) * aspect_x) * 2;
     float z_near = 1.0;
     float z_far = 50.0;
-    proj_matrix = mat4_make_perspective(fov_y, aspect_y, z_near, z_far);
+    set_projection_matrix(mat4_make_perspective(fov_y, aspect_y, z_near, z_far));
 
     // Inicializamos los planos del frustum con un punto a y una normal a
     init_frustum_planes(fov_x, fov_y, z_near, z_far);
 
+    // La guard band abre los planos laterales hasta GUARD_BAND_PIXELS más allá de cada borde de la pantalla
+    int guard_band_pixels = get_guard_band_pixels(get_window_width(), get_window_height());
+    float guard_band_scale_x = (get_window_width() / 2.0 + guard_band_pixels) / (get_window_width() / 2.0);
+    float guard_band_scale_y = (get_window_height() / 2.0 + guard_band_pixels) / (get_window_height() / 2.0);
+    init_guard_band_planes(fov_x, fov_y, guard_band_scale_x, guard_band_scale_y);
+
     // Cargamos un numero limitado de meshes con sus texturas y vectores de escalado, traslación y rotación individual
-    load_mesh(
+    mesh_t *runway = load_mesh_async(
         "./assets/runway.obj",  // mesh objects
         "./assets/runway.png",  // mesh texture
         vec3_new(1, 1, 1),      // scalation vector
         vec3_new(0, -1.5, +23), // translation vector
         vec3_new(0, 0, 0));     // rotation vector
 
-    load_mesh("./assets/f117.obj", "./assets/f117.png", vec3_new(1, 1, 1), vec3_new(0, -1.3, +5), vec3_new(0, -M_PI / 2, 0));
-    load_mesh("./assets/f22.obj", "./assets/f22.png", vec3_new(1, 1, 1), vec3_new(-2, -1.3, +9), vec3_new(0, -M_PI / 2, 0));
-    load_mesh("./assets/efa.obj", "./assets/efa.png", vec3_new(1, 1, 1), vec3_new(+2, -1.3, +9), vec3_new(0, -M_PI / 2, 0));
+    // La pista y el casco del F-117 tapan lo que queda detrás, los usamos como oclusores
+    set_mesh_occluder(runway, true);
+
+    mesh_t *f117 = load_mesh_async("./assets/f117.obj", "./assets/f117.png", vec3_new(1, 1, 1), vec3_new(0, -1.3, +5), vec3_new(0, -M_PI / 2, 0));
+    set_mesh_occluder(f117, true);
+    load_mesh_async("./assets/f22.obj", "./assets/f22.png", vec3_new(1, 1, 1), vec3_new(-2, -1.3, +9), vec3_new(0, -M_PI / 2, 0));
+    load_mesh_async("./assets/efa.obj", "./assets/efa.png", vec3_new(1, 1, 1), vec3_new(+2, -1.3, +9), vec3_new(0, -M_PI / 2, 0));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -152,194 +195,67 @@ void process_input(void)
                 set_cull_method(CULL_NONE);
                 break;
             }
-            break;
-        }
-    }
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// Process the graphics pipeline stages for all the mesh triangles
-///////////////////////////////////////////////////////////////////////////////
-// +-------------+
-// | Model space |  <-- original mesh vertices
-// +-------------+
-// |   +-------------+
-// `-> | World space |  <-- multiply by world matrix
-//     +-------------+
-//     |   +--------------+
-//     `-> | Camera space |  <-- multiply by view matrix
-//         +--------------+
-//         |    +------------+
-//         `--> |  Clipping  |  <-- clip against the six frustum planes
-//              +------------+
-//              |    +------------+
-//              `--> | Projection |  <-- multiply by projection matrix
-//                   +------------+
-//                   |    +-------------+
-//                   `--> | Image space |  <-- apply perspective divide
-//                        +-------------+
-//                        |    +--------------+
-//                        `--> | Screen space |  <-- ready to render
-//                             +--------------+
-///////////////////////////////////////////////////////////////////////////////
-void process_graphics_pipeline_stages(mesh_t *mesh)
-{
-    // Crear matriz de escalado, rotación y traslación que utilizará el multiplicador del mesh vertices
-    mat4_t scale_matrix = mat4_make_scale(mesh->scale.x, mesh->scale.y, mesh->scale.z);
-    mat4_t translation_matrix = mat4_make_translation(mesh->translation.x, mesh->translation.y, mesh->translation.z);
-    mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh->rotation.x);
-    mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh->rotation.y);
-    mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh->rotation.z);
-
-    // Actualizamos el camaera look at para crear la matriz de vista
-    vec3_t target = get_camera_lookat_target();
-    vec3_t up_direction = vec3_new(0, 1, 0);
-    view_matrix = mat4_look_at(get_camera_position(), target, up_direction);
-
-    // Iteramos todas las caras de la malla
-    int num_faces = array_length(mesh->faces);
-    for (int i = 0; i < num_faces; i++)
-    {
-        face_t mesh_face = mesh->faces[i];
-
-        vec3_t face_vertices[3];
-        face_vertices[0] = mesh->vertices[mesh_face.a];
-        face_vertices[1] = mesh->vertices[mesh_face.b];
-        face_vertices[2] = mesh->vertices[mesh_face.c];
-
-        vec4_t transformed_vertices[3];
-
-        // TRANSFORMACIONES: Iteramos los 3 vértices de la cara actual
-        // Loop all three vertices of this current face and apply transformations
-        for (int j = 0; j < 3; j++)
-        {
-            vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
-
-            // Creamos una matriz de mundo combinando escalado, rotación y traslación de matrices
-            world_matrix = mat4_identity();
-
-            // Multiplicamos todas las matrices para cargar la matriz de mundo
-            // La matriz de la izquierda es la que transforma la matriz de la derecha
-            // IMPORTANTE: El orden de las transformaciones debe tenerse en cuenta
-            //             1. Escalar  2. Rotar  3. Trasladar
-            //                    [T] * [R] * [S] * v
-            world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
-            world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-            world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-            world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-            world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
-
-            // Multiplicamos la matriz de mundo por el vector original del vertice
-            transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
-
-            // Multipicamos la matriz de vista por el vector para transformar la escena a al espacio de la cámara
-            transformed_vertex = mat4_mul_vec4(view_matrix, transformed_vertex);
-
-            // Guardamos el vértice transformado en el array
-            transformed_vertices[j] = transformed_vertex;
-        }
-
-        // Calculamos la normal de los triángulos
-        vec3_t face_normal = get_triangle_normal(transformed_vertices);
-
-        // Si el triángulo no está alineado con la cámara saltamos la iteración
-        if (is_cull_backface())
-        {
-            // Buscamos el vector entre un punto del trángulo y el origen de la cámara
-            // Figura "docs/15 camera raycast.png"
-            vec3_t camera_ray = vec3_sub(vec3_new(0, 0, 0), vec3_from_vec4(transformed_vertices[0]));
-
-            // Calculamos cuán alineado está el camera_ray respecto al vector normal
-            // Utilizando para ello el producto escalar (el orden de los vectores no importa)
-            float dot_normal_camera = vec3_dot(face_normal, camera_ray);
-
-            // Backface culling, bypassing triangles that are looking away from the camera
-            if (dot_normal_camera < 0)
-                continue;
-        }
-
-        // Clipping!!
-        // Creamos un polígono a partir del triángulo original transformado
-        polygon_t polygon = polygon_from_triangle(
-            vec3_from_vec4(transformed_vertices[0]),
-            vec3_from_vec4(transformed_vertices[1]),
-            vec3_from_vec4(transformed_vertices[2]),
-            mesh_face.a_uv,
-            mesh_face.b_uv,
-            mesh_face.c_uv);
-
-        // Clipeamos el polígono y retornmos el nuevo polígono con potenciales nuevos vértices
-        clip_polygon(&polygon);
-
-        // Después del clipping tenemos que romper el poligono en triángulos
-        triangle_t triangles_after_clipping[MAX_NUM_POLY_TRIANGLES];
-        int num_triangles_after_clipping = 0;
-
-        triangles_from_polygon(&polygon, triangles_after_clipping, &num_triangles_after_clipping);
-
-        // Iteramos todos los triángulos ensamblados después del clipping
-        for (int t = 0; t < num_triangles_after_clipping; t++)
-        {
-            triangle_t triangle_after_clipping = triangles_after_clipping[t];
-
-            // PROYECCIONES: Iteramos los 3 vértices de la cara actual
-            vec4_t projected_points[3];
-
-            for (int j = 0; j < 3; j++)
+            if (event.key.keysym.sym == SDLK_r) // cycle between the SIMD edge, scalar edge and scanline rasterizers
             {
-                // Proyectamos el vértice
-                projected_points[j] = mat4_mul_vec4(proj_matrix, triangle_after_clipping.points[j]);
-
-                // Ejecutamos la división de la perspectiva
-                if (projected_points[j].w != 0)
-                {
-                    projected_points[j].x /= projected_points[j].w;
-                    projected_points[j].y /= projected_points[j].w;
-                    projected_points[j].z /= projected_points[j].w;
-                }
-
-                // Invertimos los valores 'y' debido a los valores invertidos de la pantalla
-                // Figura 34 valores invertidos.png
-                projected_points[j].y *= -1;
-
-                // Escalamos en la vista
-                projected_points[j].x *= (get_window_width() / 2.0);
-                projected_points[j].y *= (get_window_height() / 2.0);
-
-                // Trasladamos los puntos proyectados al centro de la pantalla
-                projected_points[j].x += (get_window_width() / 2.0);
-                projected_points[j].y += (get_window_height() / 2.0);
+                if (get_raster_method() == RASTER_EDGE_SIMD)
+                    set_raster_method(RASTER_EDGE);
+                else if (get_raster_method() == RASTER_EDGE)
+                    set_raster_method(RASTER_SCANLINE);
+                else
+                    set_raster_method(RASTER_EDGE_SIMD);
+                break;
             }
-
-            // Calculamos la intensidad del sombreado basándonos en cuán alineados están la normal de la cara del triángulo y la inversa de la luz (lo negamos por lo de que la profundidad va hacia dentro en nuestro modelo, y en cambio la luz se refleja hacia fuera a nuestra cámara, por eso si no lo negamos se nos oscurece al revés)
-            float light_intensity_factor = -vec3_dot(face_normal, get_light_direction());
-
-            // Calculamos el color del triángulo basados en el ángulo de la luz
-            uint32_t triangle_color = light_apply_intensity(mesh_face.color, light_intensity_factor);
-
-            triangle_t triangle_to_render = {
-                .points = {
-                    {projected_points[0].x, projected_points[0].y, projected_points[0].z, projected_points[0].w},
-                    {projected_points[1].x, projected_points[1].y, projected_points[1].z, projected_points[1].w},
-                    {projected_points[2].x, projected_points[2].y, projected_points[2].z, projected_points[2].w},
-                },
-                .texcoords = {
-                    {triangle_after_clipping.texcoords[0].u, triangle_after_clipping.texcoords[0].v},
-                    {triangle_after_clipping.texcoords[1].u, triangle_after_clipping.texcoords[1].v},
-                    {triangle_after_clipping.texcoords[2].u, triangle_after_clipping.texcoords[2].v},
-                },
-                .color = triangle_color,
-                .texture = mesh->texture,
-            };
-
-            // Guardamos el triángulo proyectado en el array de triángulos a renderizar
-            // almacenar datos en memoria y borrarlos así es muy cpu dependiente, gasta mucho
-            //array_push(triangles_to_render, projected_triangle);
-            // mil veces mejor hacerlo en memoria reservada
-            if (num_triangles_to_render < MAX_TRIANGLES)
+            if (event.key.keysym.sym == SDLK_t) // toggle between tiled parallel and serial rasterization
+            {
+                is_tiled_rendering = !is_tiled_rendering;
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_f) // toggle sub-pixel precision with the top-left fill rule
+            {
+                set_subpixel_precision(!is_subpixel_precision());
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_h) // toggle the hierarchical z-buffer rejection
+            {
+                set_hiz_culling(!is_hiz_culling());
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_o) // toggle the software occlusion culling of whole meshes
+            {
+                set_occlusion_culling(!is_occlusion_culling());
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_z) // toggle the front-to-back sort of the triangles
+            {
+                is_sorting_triangles = !is_sorting_triangles;
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_v) // toggle the visibility buffer (shade each pixel once after rasterizing)
+            {
+                set_visibility_buffer_mode(!is_visibility_buffer_mode());
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_g) // toggle guard-band clipping (only near/far for triangles inside the band)
+            {
+                set_guard_band_clipping(!is_guard_band_clipping());
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_l) // toggle the automatic level of detail of small meshes on screen
             {
-                triangles_to_render[num_triangles_to_render++] = triangle_to_render;
+                set_lod_selection(!is_lod_selection());
+                break;
+            }
+            if (event.key.keysym.sym == SDLK_k) // toggle the hysteresis when switching between levels of detail
+            {
+                set_lod_hysteresis(!is_lod_hysteresis());
+                break;
             }
+            if (event.key.keysym.sym == SDLK_i) // toggle printing the frame stats every second
+            {
+                is_printing_stats = !is_printing_stats;
+                break;
+            }
+            break;
         }
     }
 }
@@ -349,6 +265,9 @@ void process_graphics_pipeline_stages(mesh_t *mesh)
 ///////////////////////////////////////////////////////////////////////////////
 void update(void)
 {
+    // Todo lo que reservó el frame anterior se libera de golpe
+    reset_frame_arena();
+
     // Esto genera un bucle para capar los FPS, pero consume toda la CPU
     // while (!SDL_TICKS_PASSED(SDL_GetTicks(), previous_frame_time + FRAME_TARGET_TIME));
     // En su lugar usaremos SDL_Delay a nivel de SO para poner en IDLE el proceso un tiempo
@@ -364,79 +283,167 @@ void update(void)
     // Cuantos milisegundos han pasado desde que empieza el juego
     previous_frame_time = SDL_GetTicks();
 
-    // Reiniciamos el numero de triángulos a dibujar en el frame actual
-    num_triangles_to_render = 0;
+    // Las mallas que han terminado de cargarse entran en la escena a partir de este frame
+    update_asset_loader();
+
+    // La matriz de vista se reconstruye una vez por frame y solo si la cámara se ha movido
+    update_view_matrix();
+
+    // Los contadores del frame empiezan antes de la etapa de geometría
+    reset_frame_stats();
+
+    // Process graphics pipeline stages for every mesh of our 3D scene,
+    // the work is split across the worker threads
+    process_graphics_pipeline_stages();
 
-    // Iteramos todos los meshes de la escena
-    for (int mesh_index = 0; mesh_index < get_num_meshes(); mesh_index++)
+    // Ordenamos de delante hacia atrás para que el test de profundidad descarte
+    // los píxeles tapados antes de texturizarlos
+    if (is_sorting_triangles)
+        sort_triangles_to_render();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Draw the wireframe and vertices of a triangle if the render method asks for them
+///////////////////////////////////////////////////////////////////////////////
+void draw_triangle_wireframe(triangle_t *triangle)
+{
+    // Draw triangle wireframe
+    if (should_render_wireframe())
+    {
+        draw_triangle(
+            triangle->points[0].x, triangle->points[0].y, // vertex A
+            triangle->points[1].x, triangle->points[1].y, // vertex B
+            triangle->points[2].x, triangle->points[2].y, // vertex C
+            0xFFFFFFFF);
+    }
+
+    // Draw triangle vertex points
+    if (should_render_wire_vertex())
     {
-        mesh_t *mesh = get_mesh(mesh_index);
+        draw_rect(triangle->points[0].x - 3, triangle->points[0].y - 3, 6, 6, 0xFF0000FF); // vertex A
+        draw_rect(triangle->points[1].x - 3, triangle->points[1].y - 3, 6, 6, 0xFF0000FF); // vertex B
+        draw_rect(triangle->points[2].x - 3, triangle->points[2].y - 3, 6, 6, 0xFF0000FF); // vertex C
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Draw a single triangle with the current render method
+///////////////////////////////////////////////////////////////////////////////
+void draw_triangle_to_render(triangle_t *triangle, triangle_setup_t *setup)
+{
+    // Draw filled triangle
+    if (should_render_filled_triangle() && get_raster_method() != RASTER_SCANLINE)
+        draw_filled_triangle_edge(setup, triangle->color);
+    else if (should_render_filled_triangle())
+        draw_filled_triangle(setup, triangle->color);
+
+    // Draw textured triangle
+    if (should_render_textured_triangle() && get_raster_method() != RASTER_SCANLINE)
+        draw_textured_triangle_edge(setup, triangle->texture);
+    else if (should_render_textured_triangle())
+        draw_textured_triangle(setup, triangle->texture);
+
+    draw_triangle_wireframe(triangle);
+}
 
-        // Cambiamos los valores del mesh scale/rotation en cada frame
-        // mesh.rotation.x += 0.0 * delta_time; // 1 pixel por segundo
-        // mesh.rotation.y += 0.0 * delta_time;
-        // mesh.rotation.z += 0.0 * delta_time;
-        // mesh.translation.z = 5.0;
+///////////////////////////////////////////////////////////////////////////////
+// Draw a list of triangles (all of them in order if indices is NULL)
+///////////////////////////////////////////////////////////////////////////////
+void draw_triangles_to_render(int *indices, int num_triangles)
+{
+    triangle_t *triangles_to_render = get_triangles_to_render();
+    triangle_setup_t *triangle_setups = get_triangle_setups();
 
-        // Process graphics pipeline stages for each mesh of our 3D scene
-        process_graphics_pipeline_stages(mesh);
+    if (!is_visibility_buffer_mode())
+    {
+        for (int i = 0; i < num_triangles; i++)
+        {
+            int index = indices != NULL ? indices[i] : i;
+            draw_triangle_to_render(&triangles_to_render[index], &triangle_setups[index]);
+        }
+        return;
+    }
+
+    // Buffer de visibilidad: primero solo profundidad e identificador (índice + 1),
+    // después sombreamos cada píxel una vez y encima dibujamos las aristas
+    clear_visibility_buffer();
+    if (should_render_filled_triangle() || should_render_textured_triangle())
+    {
+        for (int i = 0; i < num_triangles; i++)
+        {
+            int index = indices != NULL ? indices[i] : i;
+            if (get_raster_method() != RASTER_SCANLINE)
+                draw_visibility_triangle_edge(&triangle_setups[index], index + 1);
+            else
+                draw_visibility_triangle(&triangle_setups[index], index + 1);
+        }
+        resolve_visibility_buffer(triangles_to_render, triangle_setups);
     }
+
+    for (int i = 0; i < num_triangles; i++)
+        draw_triangle_wireframe(&triangles_to_render[indices != NULL ? indices[i] : i]);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Render function to draw objects on the display
+// Render all the triangles binned into one screen tile
 ///////////////////////////////////////////////////////////////////////////////
-void render(void)
+// Cada hilo solo escribe dentro de su tile, los buffers no necesitan bloqueos
+void render_tile_job(void *data, int job_index, int thread_index)
 {
-    // Reseteamos los buffers para preparar el siguiente frame
+    tile_t *tile = get_tile(job_index);
+
+    set_clip_rect(tile->rect);
+    set_stats_thread(thread_index);
+
+    // Reseteamos los buffers del tile para preparar el siguiente frame
     clear_color_buffer(0xFF000000);
     clear_z_buffer();
 
     // Dibujamos la cuadrícula
     draw_grid();
 
-    // Iteramos los triángulos a renderizar
-    for (int i = 0; i < num_triangles_to_render; i++)
+    // Los índices están en el orden original, igual que en el renderizado serie
+    draw_triangles_to_render(tile->triangles, array_length(tile->triangles));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Render function to draw objects on the display
+///////////////////////////////////////////////////////////////////////////////
+void render(void)
+{
+    triangle_t *triangles_to_render = get_triangles_to_render();
+    int num_triangles_to_render = get_num_triangles_to_render();
+
+    // Calculamos una sola vez los planos de los atributos de cada triángulo,
+    // todos los rasterizadores (y todos los tiles que lo tocan) los comparten
+    setup_triangles_to_render();
+
+    if (is_tiled_rendering)
     {
-        triangle_t triangle = triangles_to_render[i];
+        // Repartimos los triángulos en tiles y los rasterizamos en paralelo
+        bin_triangles(triangles_to_render, num_triangles_to_render, TILE_MARGIN);
+        run_parallel_jobs(render_tile_job, NULL, get_num_tiles());
+        reset_clip_rect();
+    }
+    else
+    {
+        reset_clip_rect();
 
-        // Draw filled triangle
-        if (should_render_filled_triangle())
-        {
-            draw_filled_triangle(
-                triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, // vertex A
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, // vertex B
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, // vertex C
-                triangle.color);
-        }
+        // Reseteamos los buffers para preparar el siguiente frame
+        clear_color_buffer(0xFF000000);
+        clear_z_buffer();
 
-        // Draw textured triangle
-        if (should_render_textured_triangle())
-        {
-            draw_textured_triangle(
-                triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, triangle.texcoords[0].u, triangle.texcoords[0].v, // vertex A
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, triangle.texcoords[1].u, triangle.texcoords[1].v, // vertex B
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, triangle.texcoords[2].u, triangle.texcoords[2].v, // vertex C
-                triangle.texture);
-        }
+        // Dibujamos la cuadrícula
+        draw_grid();
 
-        // Draw triangle wireframe
-        if (should_render_wireframe())
-        {
-            draw_triangle(
-                triangle.points[0].x, triangle.points[0].y, // vertex A
-                triangle.points[1].x, triangle.points[1].y, // vertex B
-                triangle.points[2].x, triangle.points[2].y, // vertex C
-                0xFFFFFFFF);
-        }
+        // Iteramos los triángulos a renderizar
+        draw_triangles_to_render(NULL, num_triangles_to_render);
+    }
 
-        // Draw triangle vertex points
-        if (should_render_wire_vertex())
-        {
-            draw_rect(triangle.points[0].x - 3, triangle.points[0].y - 3, 6, 6, 0xFF0000FF); // vertex A
-            draw_rect(triangle.points[1].x - 3, triangle.points[1].y - 3, 6, 6, 0xFF0000FF); // vertex B
-            draw_rect(triangle.points[2].x - 3, triangle.points[2].y - 3, 6, 6, 0xFF0000FF); // vertex C
-        }
+    if (is_printing_stats && stats_frame_count++ % FPS == 0)
+    {
+        add_frame_arena_stats();
+        print_frame_stats();
     }
 
     // Copiamos el color buffer a la textura y lo limpiamos
@@ -448,7 +455,14 @@ void render(void)
 ///////////////////////////////////////////////////////////////////////////////
 void free_resources(void)
 {
+    free_asset_loader();
+    destroy_thread_pool();
+    free_tiles();
+    free_pipeline();
+    free_occlusion();
+    free_scene_bvh();
     free_meshes();
+    free_asset_cache();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
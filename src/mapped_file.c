@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL2/SDL.h>
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Read-only file mapping (MapViewOfFile on Windows, mmap elsewhere)
+///////////////////////////////////////////////////////////////////////////////
+// El sistema carga cada página la primera vez que se lee, así que abrir un
+// fichero enorme no cuesta nada hasta que se usa y las páginas se comparten
+// con la caché de disco en lugar de copiarse a memoria propia
+///////////////////////////////////////////////////////////////////////////////
+bool map_file(char *filename, mapped_file_t *file)
+{
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    // El mapping mantiene el fichero abierto, podemos cerrar el handle ya
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL)
+        return false;
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    file->data = (unsigned char *)data;
+    file->size = size.QuadPart;
+    file->handle = mapping;
+#else
+    int descriptor = open(filename, O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+    {
+        close(descriptor);
+        return false;
+    }
+
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (data == MAP_FAILED)
+        return false;
+
+    file->data = (unsigned char *)data;
+    file->size = info.st_size;
+#endif
+    return true;
+}
+
+void unmap_file(mapped_file_t *file)
+{
+    if (file->data == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE)file->handle);
+#else
+    munmap(file->data, file->size);
+#endif
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+}
+
+bool get_file_info(char *filename, file_info_t *info)
+{
+    struct stat status;
+    if (stat(filename, &status) != 0)
+        return false;
+
+    info->mtime = (int64_t)status.st_mtime;
+    info->size = (int64_t)status.st_size;
+    return true;
+}
+
+// Número de temporales abiertos por este proceso, distingue los de cada hilo
+static SDL_atomic_t num_temporary_files;
+
+// Crea junto a filename un fichero nuevo que solo escribe este proceso: el nombre
+// lleva su pid y se abre en modo exclusivo, así dos procesos que generan la misma
+// caché a la vez no escriben nunca en el mismo temporal
+FILE *create_temporary_file(char *filename, char **temporary_filename)
+{
+#ifdef _WIN32
+    unsigned long process_id = (unsigned long)GetCurrentProcessId();
+#else
+    unsigned long process_id = (unsigned long)getpid();
+#endif
+    int length = strlen(filename) + 48;
+    *temporary_filename = (char *)malloc(length);
+
+    // Si queda un temporal con el mismo nombre de un proceso anterior probamos el siguiente
+    for (int attempt = 0; attempt < 16; attempt++)
+    {
+        int counter = SDL_AtomicAdd(&num_temporary_files, 1);
+        snprintf(*temporary_filename, length, "%s.%lu.%d.tmp", filename, process_id, counter);
+        FILE *file = fopen(*temporary_filename, "wbx");
+        if (file != NULL)
+            return file;
+    }
+
+    free(*temporary_filename);
+    *temporary_filename = NULL;
+    return NULL;
+}
+
+// Sustituye un fichero por otro ya escrito entero, así nunca queda una caché a medias
+bool replace_file(char *temporary_filename, char *filename)
+{
+#ifdef _WIN32
+    return MoveFileExA(temporary_filename, filename, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(temporary_filename, filename) == 0;
+#endif
+}
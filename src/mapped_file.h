@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fichero proyectado en memoria de solo lectura, las páginas se cargan al tocarlas
+typedef struct mapped_file_t
+{
+    unsigned char *data;
+    int64_t size;
+    void *handle;  // mapping de Windows (NULL con mmap)
+} mapped_file_t;
+
+// Fecha de modificación y tamaño de un fichero, para saber si una caché sigue siendo válida
+typedef struct file_info_t
+{
+    int64_t mtime;
+    int64_t size;
+} file_info_t;
+
+bool map_file(char *filename, mapped_file_t *file);
+void unmap_file(mapped_file_t *file);
+bool get_file_info(char *filename, file_info_t *info);
+FILE *create_temporary_file(char *filename, char **temporary_filename);
+bool replace_file(char *temporary_filename, char *filename);
+
+#endif
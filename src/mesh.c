@@ -1,106 +1,288 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "array.h"
 #include "mesh.h"
+#include "clipping.h"
+#include "simd.h"
+#include "asset_cache.h"
+#include "obj_parser.h"
 
-#define MAX_NUM_MESHES 10
-static mesh_t meshes[MAX_NUM_MESHES];
-static int mesh_count = 0;
+// La escena crece sin límite, cada malla se reserva aparte para que los punteros
+// (trabajos, jerarquía, oclusores) sigan siendo válidos al añadir más
+static mesh_t **meshes = NULL;
 
-void load_mesh(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation)
+// Mallas cuya escala, rotación o traslación ha cambiado desde el último frame
+static mesh_t **dirty_meshes = NULL;
+static void mark_mesh_dirty(mesh_t *mesh);
+
+// Si está activo las mallas guardan también sus posiciones en SoA al cargarse
+static bool use_soa_layout = true;
+
+void set_mesh_soa_layout(bool enabled)
+{
+    use_soa_layout = enabled;
+}
+
+bool is_mesh_soa_layout(void)
+{
+    return use_soa_layout;
+}
+
+mesh_t *load_mesh(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation)
+{
+    // La caché solo lee y decodifica cada OBJ y cada PNG la primera vez
+    mesh_t source = {
+        .geometry = get_cached_geometry(obj_filename),
+        .texture = get_cached_texture(png_filename),
+    };
+    if (source.geometry == NULL)
+        return NULL;
+
+    return add_mesh_instance(&source, scale, translation, rotation);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Place another copy of a mesh, sharing its geometry and texture
+///////////////////////////////////////////////////////////////////////////////
+mesh_t *add_mesh_instance(mesh_t *source, vec3_t scale, vec3_t translation, vec3_t rotation)
 {
-    // Cargamos el fichero OBJ en la mesh
-    load_mesh_obj_data(&meshes[mesh_count], obj_filename);
+    mesh_t *mesh = create_mesh_instance(source, scale, translation, rotation);
+    add_mesh_to_scene(mesh);
+    return mesh;
+}
 
-    // Cargamos el fichero PNG en la textura
-    load_mesh_png_data(&meshes[mesh_count], png_filename);
+// Instancia fuera de la escena, la carga asíncrona la añade cuando tiene su geometría
+mesh_t *create_mesh_instance(mesh_t *source, vec3_t scale, vec3_t translation, vec3_t rotation)
+{
+    mesh_t *mesh = (mesh_t *)calloc(1, sizeof(mesh_t));
+    mesh->geometry = source->geometry;
+    mesh->texture = source->texture;
 
     // Inicializamos el escalado, la traslación y rotación con los parámetros
-    meshes[mesh_count].scale = scale;
-    meshes[mesh_count].translation = translation;
-    meshes[mesh_count].rotation = rotation;
+    mesh->scale = scale;
+    mesh->translation = translation;
+    mesh->rotation = rotation;
+
+    // Ya cuenta como sucia, así moverla antes de añadirla no la mete en la lista de sucias
+    mesh->transform.is_dirty = true;
+    return mesh;
+}
+
+void add_mesh_to_scene(mesh_t *mesh)
+{
+    // Añadimos la mesh al array de meshes y la marcamos para calcular su caja en el próximo frame
+    array_push(meshes, mesh);
+    mesh->transform.is_dirty = false;
+    mark_mesh_dirty(mesh);
+}
+
+void load_mesh_obj_data(mesh_geometry_t *geometry, char *obj_filename)
+{
+    // El parser proyecta el fichero y lo reparte entre los hilos del pool
+    if (!parse_obj_file(obj_filename, &geometry->vertices, &geometry->faces))
+        printf("%s: could not read the OBJ file\n", obj_filename);
+
+    load_mesh_bounds(geometry);
 
-    // Añadimos la mesh al array de meshes
-    mesh_count++;
+    if (use_soa_layout)
+        load_mesh_soa_positions(geometry);
 }
 
-void load_mesh_obj_data(mesh_t *mesh, char *obj_filename)
+// Copiamos las posiciones a tres arrays alineados x/y/z (structure of arrays)
+// rellenando con ceros hasta un múltiplo del ancho SIMD para evitar colas
+void load_mesh_soa_positions(mesh_geometry_t *geometry)
 {
-    FILE *file;
-    file = fopen(obj_filename, "r");
-    char line[1024];
+    int num_vertices = array_length(geometry->vertices);
+    int padded_count = simd_padded_count(num_vertices);
 
-    tex2_t *texcoords = NULL;
+    geometry->positions_x = simd_alloc(sizeof(float) * padded_count);
+    geometry->positions_y = simd_alloc(sizeof(float) * padded_count);
+    geometry->positions_z = simd_alloc(sizeof(float) * padded_count);
 
-    while (fgets(line, 1024, file))
+    for (int i = 0; i < padded_count; i++)
     {
-        // Vertex information
-        if (strncmp(line, "v ", 2) == 0)
-        {
-            vec3_t vertex;
-            sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            array_push(mesh->vertices, vertex);
-        }
-        // Texture coordinate information
-        if (strncmp(line, "vt ", 3) == 0)
-        {
-            tex2_t texcoord;
-            sscanf(line, "vt %f %f", &texcoord.u, &texcoord.v);
-            array_push(texcoords, texcoord);
-        }
-        // Face information
-        if (strncmp(line, "f ", 2) == 0)
-        {
-            int vertex_indices[3];
-            int texture_indices[3];
-            int normal_indices[3];
-            sscanf(
-                line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertex_indices[0], &texture_indices[0], &normal_indices[0],
-                &vertex_indices[1], &texture_indices[1], &normal_indices[1],
-                &vertex_indices[2], &texture_indices[2], &normal_indices[2]);
-            face_t face = {
-                .a = vertex_indices[0] - 1,
-                .b = vertex_indices[1] - 1,
-                .c = vertex_indices[2] - 1,
-                .a_uv = texcoords[texture_indices[0] - 1],
-                .b_uv = texcoords[texture_indices[1] - 1],
-                .c_uv = texcoords[texture_indices[2] - 1],
-                .color = 0xFFFFFFFF};
-            array_push(mesh->faces, face);
-        }
+        vec3_t vertex = i < num_vertices ? geometry->vertices[i] : vec3_new(0, 0, 0);
+        geometry->positions_x[i] = vertex.x;
+        geometry->positions_y[i] = vertex.y;
+        geometry->positions_z[i] = vertex.z;
+    }
+}
+
+// Caja alineada con los ejes y esfera en espacio local, sirven para descartar la malla entera
+void load_mesh_bounds(mesh_geometry_t *geometry)
+{
+    int num_vertices = array_length(geometry->vertices);
+    if (num_vertices == 0)
+        return;
+
+    geometry->bounds_min = geometry->vertices[0];
+    geometry->bounds_max = geometry->vertices[0];
+    for (int i = 1; i < num_vertices; i++)
+    {
+        vec3_t vertex = geometry->vertices[i];
+        geometry->bounds_min.x = vertex.x < geometry->bounds_min.x ? vertex.x : geometry->bounds_min.x;
+        geometry->bounds_min.y = vertex.y < geometry->bounds_min.y ? vertex.y : geometry->bounds_min.y;
+        geometry->bounds_min.z = vertex.z < geometry->bounds_min.z ? vertex.z : geometry->bounds_min.z;
+        geometry->bounds_max.x = vertex.x > geometry->bounds_max.x ? vertex.x : geometry->bounds_max.x;
+        geometry->bounds_max.y = vertex.y > geometry->bounds_max.y ? vertex.y : geometry->bounds_max.y;
+        geometry->bounds_max.z = vertex.z > geometry->bounds_max.z ? vertex.z : geometry->bounds_max.z;
+    }
+
+    // La esfera se centra en la caja y llega hasta el vértice más alejado
+    geometry->bounds_center = vec3_mul(vec3_add(geometry->bounds_min, geometry->bounds_max), 0.5);
+    geometry->bounds_radius = 0;
+    for (int i = 0; i < num_vertices; i++)
+    {
+        float distance = vec3_length(vec3_sub(geometry->vertices[i], geometry->bounds_center));
+        geometry->bounds_radius = distance > geometry->bounds_radius ? distance : geometry->bounds_radius;
     }
 }
 
-void load_mesh_png_data(mesh_t *mesh, char *png_filename)
+void free_mesh_geometry(mesh_geometry_t *geometry)
 {
-    upng_t *png_image = upng_new_from_file(png_filename);
-    if (png_image != NULL)
+    // Si los arrays apuntan a la caché proyectada basta con soltar el fichero
+    mapped_file_t *cache_file = geometry->cache_file;
+
+    // Los niveles simplificados solo se guardan en la geometría original
+    for (int i = geometry->num_lods - 1; i >= 0; i--)
     {
-        upng_decode(png_image);
-        if (upng_get_error(png_image) == UPNG_EOK)
+        mesh_geometry_t *level = geometry->lods[i];
+        if (cache_file != NULL)
         {
-            mesh->texture = png_image;
+            free(level);
+            continue;
         }
+        array_free(level->faces);
+        array_free(level->vertices);
+        simd_free(level->positions_x);
+        simd_free(level->positions_y);
+        simd_free(level->positions_z);
+        free(level);
     }
+
+    if (cache_file != NULL)
+    {
+        unmap_file(cache_file);
+        free(cache_file);
+    }
+}
+
+// Cada malla entra una sola vez en la lista de sucias por frame
+static void mark_mesh_dirty(mesh_t *mesh)
+{
+    if (!mesh->transform.is_dirty)
+    {
+        mesh->transform.is_dirty = true;
+        array_push(dirty_meshes, mesh);
+    }
+}
+
+void update_mesh_scale(mesh_t *mesh, vec3_t scale)
+{
+    mesh->scale = scale;
+    mark_mesh_dirty(mesh);
+}
+
+void update_mesh_rotation(mesh_t *mesh, vec3_t rotation)
+{
+    mesh->rotation = rotation;
+    mark_mesh_dirty(mesh);
+}
+
+void update_mesh_translation(mesh_t *mesh, vec3_t translation)
+{
+    mesh->translation = translation;
+    mark_mesh_dirty(mesh);
+}
+
+void update_mesh_transform(mesh_t *mesh)
+{
+    bool world_changed = mesh->transform.is_dirty;
+    update_transform(&mesh->transform, mesh->scale, mesh->rotation, mesh->translation);
+    if (!world_changed)
+        return;
+
+    // Llevamos la esfera al mundo, el radio crece con el mayor de los escalados
+    vec4_t center = mat4_mul_vec4(mesh->transform.world_matrix, vec4_from_vec3(mesh->geometry->bounds_center));
+    float max_scale = fmaxf(fabsf(mesh->scale.x), fmaxf(fabsf(mesh->scale.y), fabsf(mesh->scale.z)));
+    mesh->world_bounds_center = vec3_from_vec4(center);
+    mesh->world_bounds_radius = mesh->geometry->bounds_radius * max_scale;
+
+    // La caja de mundo envuelve las ocho esquinas transformadas de la caja local
+    for (int i = 0; i < 8; i++)
+    {
+        vec3_t corner = {
+            .x = (i & 1) ? mesh->geometry->bounds_max.x : mesh->geometry->bounds_min.x,
+            .y = (i & 2) ? mesh->geometry->bounds_max.y : mesh->geometry->bounds_min.y,
+            .z = (i & 4) ? mesh->geometry->bounds_max.z : mesh->geometry->bounds_min.z,
+        };
+        vec3_t point = vec3_from_vec4(mat4_mul_vec4(mesh->transform.world_matrix, vec4_from_vec3(corner)));
+        mesh->world_bounds_min.x = (i == 0 || point.x < mesh->world_bounds_min.x) ? point.x : mesh->world_bounds_min.x;
+        mesh->world_bounds_min.y = (i == 0 || point.y < mesh->world_bounds_min.y) ? point.y : mesh->world_bounds_min.y;
+        mesh->world_bounds_min.z = (i == 0 || point.z < mesh->world_bounds_min.z) ? point.z : mesh->world_bounds_min.z;
+        mesh->world_bounds_max.x = (i == 0 || point.x > mesh->world_bounds_max.x) ? point.x : mesh->world_bounds_max.x;
+        mesh->world_bounds_max.y = (i == 0 || point.y > mesh->world_bounds_max.y) ? point.y : mesh->world_bounds_max.y;
+        mesh->world_bounds_max.z = (i == 0 || point.z > mesh->world_bounds_max.z) ? point.z : mesh->world_bounds_max.z;
+    }
+}
+
+mesh_t **get_dirty_meshes(void)
+{
+    return dirty_meshes;
+}
+
+void clear_dirty_meshes(void)
+{
+    array_clear(dirty_meshes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Test the bounds of a mesh against the frustum planes (camera space)
+///////////////////////////////////////////////////////////////////////////////
+// Primero la esfera, que solo cuesta una transformación; si cruza algún plano
+// probamos las ocho esquinas de la caja, más ajustada para mallas alargadas
+///////////////////////////////////////////////////////////////////////////////
+bool is_mesh_outside_frustum(mesh_t *mesh)
+{
+    vec4_t center = mat4_mul_vec4(get_view_matrix(), vec4_from_vec3(mesh->world_bounds_center));
+    if (is_sphere_outside_frustum(vec3_from_vec4(center), mesh->world_bounds_radius))
+        return true;
+
+    vec3_t corners[8];
+    for (int i = 0; i < 8; i++)
+    {
+        vec3_t corner = {
+            .x = (i & 1) ? mesh->geometry->bounds_max.x : mesh->geometry->bounds_min.x,
+            .y = (i & 2) ? mesh->geometry->bounds_max.y : mesh->geometry->bounds_min.y,
+            .z = (i & 4) ? mesh->geometry->bounds_max.z : mesh->geometry->bounds_min.z,
+        };
+        corners[i] = vec3_from_vec4(mat4_mul_vec4(mesh->transform.model_view_matrix, vec4_from_vec3(corner)));
+    }
+    return is_box_outside_frustum(corners);
+}
+
+void set_mesh_occluder(mesh_t *mesh, bool is_occluder)
+{
+    mesh->is_occluder = is_occluder;
 }
 
 int get_num_meshes(void)
 {
-    return mesh_count;
+    return array_length(meshes);
 }
 
 mesh_t *get_mesh(int index)
 {
-    return &meshes[index];
+    return meshes[index];
 }
 
 void free_meshes(void)
 {
-    for (int i = 0; i < mesh_count; i++)
-    {
-        upng_free(meshes[i].texture);
-        array_free(meshes[i].faces);
-        array_free(meshes[i].vertices);
-    }
+    // Las geometrías y las texturas son de la caché de recursos
+    for (int i = 0; i < array_length(meshes); i++)
+        free(meshes[i]);
+    array_free(meshes);
+    array_free(dirty_meshes);
 }
\ No newline at end of file
@@ -3,22 +3,70 @@
 
 #include "vector.h"
 #include "triangle.h"
-#include "upng.h"
+#include "transform.h"
+#include "mapped_file.h"
 
-// Definimos una estructura para mallas de tamaño dinámico con un array de vértices y caras
-typedef struct mesh_t
+// Niveles de detalle de una geometría, el 0 es la original
+#define MAX_LOD_LEVELS 4
+
+// Geometría de un OBJ con un array de vértices y caras de tamaño dinámico,
+// la comparten todas las instancias que se cargan del mismo fichero
+typedef struct mesh_geometry_t
 {
+    int id;             // posición en la caché de recursos, agrupa las instancias
     vec3_t *vertices;   // array dinámico de vértices
+    float *positions_x; // posiciones en SoA alineadas para los kernels SIMD (opcional)
+    float *positions_y;
+    float *positions_z;
     face_t *faces;      // array dinámico de caras
-    upng_t *texture;    // mesh PNG texture pointer
+    vec3_t bounds_min;  // caja local (AABB) que envuelve todos los vértices
+    vec3_t bounds_max;
+    vec3_t bounds_center; // esfera local que envuelve todos los vértices
+    float bounds_radius;
+    struct mesh_geometry_t *lods[MAX_LOD_LEVELS]; // niveles de detalle, lods[0] es la propia geometría
+    int num_lods;
+    mapped_file_t *cache_file; // caché binaria a la que apuntan los arrays si se cargó de ella, NULL si son propios
+} mesh_geometry_t;
+
+// Instancia de la escena: geometría y textura compartidas con su propia transformación
+typedef struct mesh_t
+{
+    mesh_geometry_t *geometry; // geometría compartida (no se libera con la instancia)
+    texture_t *texture; // mesh PNG texture pointer (compartida)
     vec3_t rotation;    // rotación en x, y, z
     vec3_t scale;       // escalado en x, y, z
     vec3_t translation; // traslación en x, y, z
+    transform_t transform; // matrices cacheadas de mundo, vista y proyección
+    vec3_t world_bounds_center; // la misma esfera en espacio de mundo, se actualiza al moverse
+    float world_bounds_radius;
+    vec3_t world_bounds_min;    // caja en espacio de mundo que envuelve la caja local
+    vec3_t world_bounds_max;
+    int bvh_node;               // hoja de la jerarquía de la escena que contiene la malla
+    int lod;                    // nivel de detalle elegido en el último frame
+    bool is_occluder;      // se rasteriza en el buffer de oclusión antes que el resto
 } mesh_t;
 
-void load_mesh(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation);
-void load_mesh_obj_data(mesh_t *mesh, char *obj_filename);
-void load_mesh_png_data(mesh_t *mesh, char *png_filename);
+mesh_t *load_mesh(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation);
+mesh_t *add_mesh_instance(mesh_t *source, vec3_t scale, vec3_t translation, vec3_t rotation);
+mesh_t *create_mesh_instance(mesh_t *source, vec3_t scale, vec3_t translation, vec3_t rotation);
+void add_mesh_to_scene(mesh_t *mesh);
+void load_mesh_obj_data(mesh_geometry_t *geometry, char *obj_filename);
+void load_mesh_soa_positions(mesh_geometry_t *geometry);
+void load_mesh_bounds(mesh_geometry_t *geometry);
+void free_mesh_geometry(mesh_geometry_t *geometry);
+void set_mesh_soa_layout(bool enabled);
+bool is_mesh_soa_layout(void);
+
+// Modificar la transformación a través de estas funciones marca la caché como sucia
+void update_mesh_scale(mesh_t *mesh, vec3_t scale);
+void update_mesh_rotation(mesh_t *mesh, vec3_t rotation);
+void update_mesh_translation(mesh_t *mesh, vec3_t translation);
+void update_mesh_transform(mesh_t *mesh);
+mesh_t **get_dirty_meshes(void);
+void clear_dirty_meshes(void);
+
+void set_mesh_occluder(mesh_t *mesh, bool is_occluder);
+bool is_mesh_outside_frustum(mesh_t *mesh);
 
 int get_num_meshes(void);
 mesh_t *get_mesh(int index);
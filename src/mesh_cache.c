@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_cache.h"
+#include "array.h"
+#include "simd.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary mesh cache
+///////////////////////////////////////////////////////////////////////////////
+// La primera vez que se carga un OBJ guardamos a su lado la geometría ya
+// procesada (caras ordenadas para la caché de vértices y todos sus niveles de
+// detalle) con el mismo formato que tiene en memoria. Las siguientes veces
+// proyectamos el fichero y los arrays de la geometría apuntan directamente a
+// él: cargar una malla cuesta lo que tarde el sistema en traer sus páginas
+///////////////////////////////////////////////////////////////////////////////
+static char *get_cache_filename(char *obj_filename)
+{
+    int length = strlen(obj_filename) + strlen(MESH_CACHE_EXTENSION) + 1;
+    char *filename = (char *)malloc(length);
+    snprintf(filename, length, "%s%s", obj_filename, MESH_CACHE_EXTENSION);
+    return filename;
+}
+
+// Una sección es válida si cae entera dentro del fichero y empieza alineada
+static bool is_section_valid(mapped_file_t *file, int64_t offset, int64_t size, bool is_array)
+{
+    int64_t header_size = is_array ? ARRAY_HEADER_SIZE : 0;
+    if (offset < (int64_t)sizeof(mesh_cache_header_t) + header_size || offset % MESH_CACHE_ALIGNMENT != 0)
+        return false;
+    return size >= 0 && offset + size <= file->size;
+}
+
+static bool is_cache_valid(mapped_file_t *file)
+{
+    if (file->size < (int64_t)sizeof(mesh_cache_header_t))
+        return false;
+
+    mesh_cache_header_t *header = (mesh_cache_header_t *)file->data;
+    if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION || header->endian_tag != MESH_CACHE_ENDIAN_TAG)
+        return false;
+    if (header->vertex_size != sizeof(vec3_t) || header->face_size != sizeof(face_t))
+        return false;
+    if (header->num_lods < 1 || header->num_lods > MAX_LOD_LEVELS)
+        return false;
+
+    for (int i = 0; i < header->num_lods; i++)
+    {
+        mesh_cache_level_t *level = &header->levels[i];
+        if (level->num_vertices < 0 || level->num_faces < 0)
+            return false;
+
+        int64_t positions_size = (int64_t)sizeof(float) * simd_padded_count(level->num_vertices);
+        if (!is_section_valid(file, level->vertices_offset, (int64_t)sizeof(vec3_t) * level->num_vertices, true) ||
+            !is_section_valid(file, level->faces_offset, (int64_t)sizeof(face_t) * level->num_faces, true))
+            return false;
+        for (int j = 0; j < 3; j++)
+            if (!is_section_valid(file, level->positions_offset[j], positions_size, false))
+                return false;
+
+        // Las cabeceras de array tienen que decir lo mismo que el nivel
+        int *vertices_header = (int *)(file->data + level->vertices_offset - ARRAY_HEADER_SIZE);
+        int *faces_header = (int *)(file->data + level->faces_offset - ARRAY_HEADER_SIZE);
+        if (vertices_header[1] != level->num_vertices || faces_header[1] != level->num_faces)
+            return false;
+
+        // Ninguna cara puede apuntar fuera de los vértices de su nivel
+        face_t *faces = (face_t *)(file->data + level->faces_offset);
+        for (int f = 0; f < level->num_faces; f++)
+        {
+            if ((unsigned)faces[f].a >= (unsigned)level->num_vertices ||
+                (unsigned)faces[f].b >= (unsigned)level->num_vertices ||
+                (unsigned)faces[f].c >= (unsigned)level->num_vertices)
+                return false;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Map the cache of an OBJ file, NULL if it does not exist or is not valid
+///////////////////////////////////////////////////////////////////////////////
+// Devuelve también la fecha, el tamaño y el hash del OBJ del que salió para
+// que quien la pide decida si sigue valiendo
+///////////////////////////////////////////////////////////////////////////////
+mesh_geometry_t *map_mesh_cache(char *obj_filename, file_info_t *source_info, uint64_t *source_hash)
+{
+    char *cache_filename = get_cache_filename(obj_filename);
+    mapped_file_t *file = (mapped_file_t *)malloc(sizeof(mapped_file_t));
+    bool is_mapped = map_file(cache_filename, file);
+    free(cache_filename);
+
+    if (!is_mapped || !is_cache_valid(file))
+    {
+        unmap_file(file);
+        free(file);
+        return NULL;
+    }
+
+    mesh_cache_header_t *header = (mesh_cache_header_t *)file->data;
+    source_info->mtime = header->source_mtime;
+    source_info->size = header->source_size;
+    *source_hash = header->source_hash;
+
+    mesh_geometry_t *geometry = NULL;
+    for (int i = 0; i < header->num_lods; i++)
+    {
+        mesh_cache_level_t *cached = &header->levels[i];
+        mesh_geometry_t *level = (mesh_geometry_t *)calloc(1, sizeof(mesh_geometry_t));
+        level->vertices = (vec3_t *)(file->data + cached->vertices_offset);
+        level->faces = (face_t *)(file->data + cached->faces_offset);
+        if (is_mesh_soa_layout())
+        {
+            level->positions_x = (float *)(file->data + cached->positions_offset[0]);
+            level->positions_y = (float *)(file->data + cached->positions_offset[1]);
+            level->positions_z = (float *)(file->data + cached->positions_offset[2]);
+        }
+        level->bounds_min = cached->bounds_min;
+        level->bounds_max = cached->bounds_max;
+        level->bounds_center = cached->bounds_center;
+        level->bounds_radius = cached->bounds_radius;
+
+        if (geometry == NULL)
+            geometry = level;
+        geometry->lods[i] = level;
+    }
+    geometry->num_lods = header->num_lods;
+    geometry->cache_file = file;
+    return geometry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Write the aligned sections of the cache
+///////////////////////////////////////////////////////////////////////////////
+// Devuelve el desplazamiento de los datos, los arrays llevan delante su
+// cabecera (capacidad y ocupados) para que array_length funcione sobre el fichero
+static int64_t write_section(FILE *file, const void *data, int64_t size, bool is_array, int count)
+{
+    static const unsigned char zeros[MESH_CACHE_ALIGNMENT] = {0};
+    int64_t header_size = is_array ? ARRAY_HEADER_SIZE : 0;
+    int64_t position = ftell(file);
+    int64_t padding = (MESH_CACHE_ALIGNMENT - (position + header_size) % MESH_CACHE_ALIGNMENT) % MESH_CACHE_ALIGNMENT;
+
+    fwrite(zeros, 1, padding, file);
+    if (is_array)
+    {
+        int array_header[2] = {count, count};
+        fwrite(array_header, sizeof(int), 2, file);
+    }
+    if (size > 0)
+        fwrite(data, 1, size, file);
+    return position + padding + header_size;
+}
+
+static void write_level(FILE *file, mesh_geometry_t *level, mesh_cache_level_t *cached)
+{
+    int num_vertices = array_length(level->vertices);
+    int num_faces = array_length(level->faces);
+    cached->num_vertices = num_vertices;
+    cached->num_faces = num_faces;
+    cached->vertices_offset = write_section(file, level->vertices, (int64_t)sizeof(vec3_t) * num_vertices, true, num_vertices);
+    cached->faces_offset = write_section(file, level->faces, (int64_t)sizeof(face_t) * num_faces, true, num_faces);
+
+    // Las posiciones SoA se guardan siempre aunque ahora no se usen
+    int padded_count = simd_padded_count(num_vertices);
+    float *positions = (float *)calloc(padded_count + 1, sizeof(float));
+    for (int j = 0; j < 3; j++)
+    {
+        for (int v = 0; v < num_vertices; v++)
+            positions[v] = j == 0 ? level->vertices[v].x : (j == 1 ? level->vertices[v].y : level->vertices[v].z);
+        cached->positions_offset[j] = write_section(file, positions, (int64_t)sizeof(float) * padded_count, false, 0);
+    }
+    free(positions);
+
+    cached->bounds_min = level->bounds_min;
+    cached->bounds_max = level->bounds_max;
+    cached->bounds_center = level->bounds_center;
+    cached->bounds_radius = level->bounds_radius;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Save a processed geometry and all its levels next to its OBJ file
+///////////////////////////////////////////////////////////////////////////////
+// Se escribe en un fichero temporal y se renombra al final, si algo falla
+// la caché anterior (o ninguna) sigue en su sitio
+///////////////////////////////////////////////////////////////////////////////
+void write_mesh_cache(mesh_geometry_t *geometry, char *obj_filename, file_info_t source_info, uint64_t source_hash)
+{
+    char *cache_filename = get_cache_filename(obj_filename);
+    char *temporary_filename;
+
+    FILE *file = create_temporary_file(cache_filename, &temporary_filename);
+    if (file == NULL)
+    {
+        free(cache_filename);
+        return;
+    }
+
+    mesh_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.endian_tag = MESH_CACHE_ENDIAN_TAG;
+    header.vertex_size = sizeof(vec3_t);
+    header.face_size = sizeof(face_t);
+    header.source_mtime = source_info.mtime;
+    header.source_size = source_info.size;
+    header.source_hash = source_hash;
+    header.num_lods = geometry->num_lods > 0 ? geometry->num_lods : 1;
+
+    // La cabecera se reescribe al final con los desplazamientos de cada sección
+    fwrite(&header, sizeof(header), 1, file);
+    for (int i = 0; i < header.num_lods; i++)
+        write_level(file, geometry->num_lods > 0 ? geometry->lods[i] : geometry, &header.levels[i]);
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    bool is_written = !ferror(file);
+    is_written = fclose(file) == 0 && is_written;
+    if (!is_written || !replace_file(temporary_filename, cache_filename))
+        remove(temporary_filename);
+
+    free(cache_filename);
+    free(temporary_filename);
+}
@@ -0,0 +1,49 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdint.h>
+#include "mesh.h"
+#include "mapped_file.h"
+
+// La caché se guarda junto al OBJ con esta extensión añadida (drone.obj.mesh)
+#define MESH_CACHE_EXTENSION ".mesh"
+#define MESH_CACHE_MAGIC 0x4853454D // "MESH" leído en little-endian
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_ENDIAN_TAG 0x01020304
+// Las secciones empiezan alineadas para las cargas SIMD de las posiciones SoA
+#define MESH_CACHE_ALIGNMENT 32
+
+// Secciones de un nivel de detalle, los desplazamientos son desde el inicio del fichero
+// Vértices y caras llevan delante la cabecera de array.h para usarse sin copiarlos
+typedef struct mesh_cache_level_t
+{
+    int32_t num_vertices;
+    int32_t num_faces;
+    int64_t vertices_offset;     // vec3_t
+    int64_t faces_offset;        // face_t, índices y coordenadas UV de cada cara
+    int64_t positions_offset[3]; // x, y, z en SoA rellenados hasta simd_padded_count
+    vec3_t bounds_min;
+    vec3_t bounds_max;
+    vec3_t bounds_center;
+    float bounds_radius;
+} mesh_cache_level_t;
+
+typedef struct mesh_cache_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t endian_tag;         // se escribe en el orden del procesador (little-endian en x86)
+    uint16_t vertex_size;        // sizeof de las estructuras, si cambian la caché no vale
+    uint16_t face_size;
+    int64_t source_mtime;        // OBJ del que sale la caché
+    int64_t source_size;
+    uint64_t source_hash;
+    int32_t num_lods;
+    int32_t reserved;
+    mesh_cache_level_t levels[MAX_LOD_LEVELS];
+} mesh_cache_header_t;
+
+mesh_geometry_t *map_mesh_cache(char *obj_filename, file_info_t *source_info, uint64_t *source_hash);
+void write_mesh_cache(mesh_geometry_t *geometry, char *obj_filename, file_info_t source_info, uint64_t source_hash);
+
+#endif
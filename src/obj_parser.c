@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "obj_parser.h"
+#include "array.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Multithreaded OBJ parser
+///////////////////////////////////////////////////////////////////////////////
+// Proyectamos el fichero en memoria y lo partimos en trozos que empiezan en
+// inicio de línea. Una primera pasada en paralelo cuenta vértices, coordenadas
+// de textura y triángulos de cada trozo; con las sumas acumuladas cada trozo
+// sabe dónde escribir y cuántos vértices hay antes que él (los índices
+// negativos son relativos a ese número), así que la segunda pasada convierte
+// los números en paralelo directamente sobre los arrays finales.
+//
+// Las caras aceptan v, v/vt, v//vn y v/vt/vn con cualquier número de esquinas
+// (se triangulan en abanico); las normales no se usan y se ignoran
+///////////////////////////////////////////////////////////////////////////////
+typedef struct obj_chunk_t
+{
+    const char *begin;
+    const char *end;
+    int num_vertices;   // registros del trozo, de la primera pasada
+    int num_texcoords;
+    int num_triangles;
+    int first_vertex;   // posición en los arrays finales (suma de los trozos anteriores)
+    int first_texcoord;
+    int first_triangle;
+    int num_invalid;    // triángulos con algún vértice que no existe
+} obj_chunk_t;
+
+typedef struct obj_parser_t
+{
+    obj_chunk_t *chunks;
+    vec3_t *vertices;
+    tex2_t *texcoords;
+    face_t *faces;
+    int *face_texcoords; // índice de la coordenada de textura de cada esquina, -1 si no tiene
+    int total_vertices;
+    int total_texcoords;
+} obj_parser_t;
+
+enum obj_record
+{
+    OBJ_OTHER,
+    OBJ_VERTEX,
+    OBJ_TEXCOORD,
+    OBJ_FACE
+};
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && is_space(*p))
+        p++;
+    return p;
+}
+
+static inline const char *skip_line(const char *p, const char *end)
+{
+    while (p < end && *p != '\n')
+        p++;
+    return p < end ? p + 1 : end;
+}
+
+static inline bool is_line_end(const char *p, const char *end)
+{
+    return p >= end || *p == '\n' || *p == '#';
+}
+
+// Tipo de registro de la línea, deja el puntero justo después de la palabra clave
+static enum obj_record read_record(const char **line, const char *end)
+{
+    const char *p = skip_spaces(*line, end);
+    enum obj_record record = OBJ_OTHER;
+    int length = 0;
+
+    if (end - p >= 2 && p[0] == 'v' && is_space(p[1]))
+        record = OBJ_VERTEX, length = 1;
+    else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && is_space(p[2]))
+        record = OBJ_TEXCOORD, length = 2;
+    else if (end - p >= 2 && p[0] == 'f' && is_space(p[1]))
+        record = OBJ_FACE, length = 1;
+
+    *line = p + length;
+    return record;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Number parsing without sscanf/strtod (no locale, no copies, bounded by end)
+///////////////////////////////////////////////////////////////////////////////
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static double power_of_ten(int exponent)
+{
+    double result = 1.0;
+    bool is_negative = exponent < 0;
+    exponent = is_negative ? -exponent : exponent;
+    while (exponent > 22)
+    {
+        result *= 1e22;
+        exponent -= 22;
+    }
+    result *= powers_of_ten[exponent];
+    return is_negative ? 1.0 / result : result;
+}
+
+// Con hasta 19 dígitos significativos en un entero y una sola división o
+// multiplicación por una potencia exacta el resultado en double es el correcto
+static const char *parse_float(const char *p, const char *end, float *value)
+{
+    p = skip_spaces(p, end);
+
+    bool is_negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        is_negative = *p++ == '-';
+
+    unsigned long long mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    while (p < end && is_digit(*p))
+    {
+        if (num_digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            num_digits += mantissa > 0;
+        }
+        else
+            exponent++;
+        p++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && is_digit(*p))
+        {
+            if (num_digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                num_digits += mantissa > 0;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool is_exponent_negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            is_exponent_negative = *p++ == '-';
+        int written_exponent = 0;
+        while (p < end && is_digit(*p))
+        {
+            if (written_exponent < 10000)
+                written_exponent = written_exponent * 10 + (*p - '0');
+            p++;
+        }
+        exponent += is_exponent_negative ? -written_exponent : written_exponent;
+    }
+
+    double result = (double)mantissa;
+    if (exponent < 0 && exponent >= -22)
+        result /= powers_of_ten[-exponent];
+    else if (exponent != 0)
+        result *= power_of_ten(exponent);
+
+    *value = (float)(is_negative ? -result : result);
+    return p;
+}
+
+static const char *parse_int(const char *p, const char *end, int *value)
+{
+    bool is_negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        is_negative = *p++ == '-';
+
+    int result = 0;
+    while (p < end && is_digit(*p))
+        result = result * 10 + (*p++ - '0');
+
+    *value = is_negative ? -result : result;
+    return p;
+}
+
+// Los índices empiezan en 1, los negativos cuentan hacia atrás desde el último leído
+static inline int resolve_index(int index, int num_defined)
+{
+    if (index > 0)
+        return index - 1;
+    if (index < 0)
+        return num_defined + index;
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// First pass: count the records of a chunk
+///////////////////////////////////////////////////////////////////////////////
+static void count_chunk_records(void *data, int chunk_index, int thread_index)
+{
+    obj_chunk_t *chunk = &((obj_parser_t *)data)->chunks[chunk_index];
+    const char *p = chunk->begin;
+    const char *end = chunk->end;
+
+    while (p < end)
+    {
+        enum obj_record record = read_record(&p, end);
+        if (record == OBJ_VERTEX)
+            chunk->num_vertices++;
+        else if (record == OBJ_TEXCOORD)
+            chunk->num_texcoords++;
+        else if (record == OBJ_FACE)
+        {
+            // Cada esquina es una palabra, un polígono de n esquinas da n - 2 triángulos
+            int num_corners = 0;
+            p = skip_spaces(p, end);
+            while (!is_line_end(p, end))
+            {
+                num_corners++;
+                while (p < end && !is_space(*p) && *p != '\n')
+                    p++;
+                p = skip_spaces(p, end);
+            }
+            if (num_corners >= 3)
+                chunk->num_triangles += num_corners - 2;
+        }
+        p = skip_line(p, end);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Second pass: parse a chunk straight into the final arrays
+///////////////////////////////////////////////////////////////////////////////
+static void parse_chunk_records(void *data, int chunk_index, int thread_index)
+{
+    obj_parser_t *parser = (obj_parser_t *)data;
+    obj_chunk_t *chunk = &parser->chunks[chunk_index];
+    const char *p = chunk->begin;
+    const char *end = chunk->end;
+
+    int vertex = chunk->first_vertex;
+    int texcoord = chunk->first_texcoord;
+    int triangle = chunk->first_triangle;
+
+    while (p < end)
+    {
+        enum obj_record record = read_record(&p, end);
+        if (record == OBJ_VERTEX)
+        {
+            vec3_t *position = &parser->vertices[vertex++];
+            p = parse_float(p, end, &position->x);
+            p = parse_float(p, end, &position->y);
+            p = parse_float(p, end, &position->z);
+        }
+        else if (record == OBJ_TEXCOORD)
+        {
+            tex2_t *uv = &parser->texcoords[texcoord++];
+            p = parse_float(p, end, &uv->u);
+            p = parse_float(p, end, &uv->v);
+        }
+        else if (record == OBJ_FACE)
+        {
+            // Abanico desde la primera esquina, solo hace falta recordar la primera y la anterior
+            int first_vertex = -1, first_texcoord = -1;
+            int previous_vertex = -1, previous_texcoord = -1;
+            int num_corners = 0;
+
+            p = skip_spaces(p, end);
+            while (!is_line_end(p, end))
+            {
+                const char *token_end = p;
+                while (token_end < end && !is_space(*token_end) && *token_end != '\n')
+                    token_end++;
+
+                int vertex_index = 0, texcoord_index = 0, ignored;
+                const char *q = parse_int(p, token_end, &vertex_index);
+                if (q < token_end && *q == '/')
+                {
+                    q++;
+                    if (q < token_end && *q != '/')
+                        q = parse_int(q, token_end, &texcoord_index);
+                    if (q < token_end && *q == '/')
+                        parse_int(q + 1, token_end, &ignored);
+                }
+                int corner_vertex = resolve_index(vertex_index, vertex);
+                int corner_texcoord = resolve_index(texcoord_index, texcoord);
+
+                if (num_corners == 0)
+                {
+                    first_vertex = corner_vertex;
+                    first_texcoord = corner_texcoord;
+                }
+                else if (num_corners >= 2)
+                {
+                    face_t *face = &parser->faces[triangle];
+                    int *uv_indices = &parser->face_texcoords[triangle * 3];
+                    face->a = first_vertex;
+                    face->b = previous_vertex;
+                    face->c = corner_vertex;
+                    face->color = 0xFFFFFFFF;
+                    uv_indices[0] = first_texcoord;
+                    uv_indices[1] = previous_texcoord;
+                    uv_indices[2] = corner_texcoord;
+
+                    // Marcamos los triángulos que apuntan a vértices que no existen para quitarlos después
+                    if ((unsigned)face->a >= (unsigned)parser->total_vertices ||
+                        (unsigned)face->b >= (unsigned)parser->total_vertices ||
+                        (unsigned)face->c >= (unsigned)parser->total_vertices)
+                    {
+                        face->a = -1;
+                        chunk->num_invalid++;
+                    }
+                    triangle++;
+                }
+                previous_vertex = corner_vertex;
+                previous_texcoord = corner_texcoord;
+                num_corners++;
+
+                p = skip_spaces(token_end, end);
+            }
+        }
+        p = skip_line(p, end);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Third pass: copy the texture coordinates of the faces once all are parsed
+///////////////////////////////////////////////////////////////////////////////
+static void resolve_chunk_texcoords(void *data, int chunk_index, int thread_index)
+{
+    obj_parser_t *parser = (obj_parser_t *)data;
+    obj_chunk_t *chunk = &parser->chunks[chunk_index];
+
+    for (int t = chunk->first_triangle; t < chunk->first_triangle + chunk->num_triangles; t++)
+    {
+        tex2_t *uvs[3] = {&parser->faces[t].a_uv, &parser->faces[t].b_uv, &parser->faces[t].c_uv};
+        for (int j = 0; j < 3; j++)
+        {
+            int index = parser->face_texcoords[t * 3 + j];
+            bool is_valid = (unsigned)index < (unsigned)parser->total_texcoords;
+            *uvs[j] = is_valid ? parser->texcoords[index] : (tex2_t){0, 0};
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parse an OBJ file into dynamic arrays of vertices and triangles
+///////////////////////////////////////////////////////////////////////////////
+bool parse_obj_file(char *obj_filename, vec3_t **vertices, face_t **faces)
+{
+    mapped_file_t file;
+    if (!map_file(obj_filename, &file))
+        return false;
+
+    const char *begin = (const char *)file.data;
+    const char *end = begin + file.size;
+
+    // Partimos el fichero en trozos que empiezan justo después de un salto de línea
+    int num_chunks = (int)(file.size / OBJ_MIN_CHUNK_SIZE) + 1;
+    int max_chunks = get_num_threads() * OBJ_CHUNKS_PER_THREAD;
+    num_chunks = num_chunks > max_chunks ? max_chunks : num_chunks;
+
+    obj_parser_t parser = {
+        .chunks = (obj_chunk_t *)calloc(num_chunks, sizeof(obj_chunk_t)),
+    };
+    const char *chunk_begin = begin;
+    for (int i = 0; i < num_chunks; i++)
+    {
+        const char *chunk_end = i == num_chunks - 1 ? end : begin + file.size * (i + 1) / num_chunks;
+        if (chunk_end < chunk_begin)
+            chunk_end = chunk_begin;
+        if (chunk_end > begin && chunk_end < end && chunk_end[-1] != '\n')
+            chunk_end = skip_line(chunk_end, end);
+        parser.chunks[i].begin = chunk_begin;
+        parser.chunks[i].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    run_parallel_jobs(count_chunk_records, &parser, num_chunks);
+
+    int total_triangles = 0;
+    for (int i = 0; i < num_chunks; i++)
+    {
+        parser.chunks[i].first_vertex = parser.total_vertices;
+        parser.chunks[i].first_texcoord = parser.total_texcoords;
+        parser.chunks[i].first_triangle = total_triangles;
+        parser.total_vertices += parser.chunks[i].num_vertices;
+        parser.total_texcoords += parser.chunks[i].num_texcoords;
+        total_triangles += parser.chunks[i].num_triangles;
+    }
+
+    // Reservamos los arrays finales de una vez con su tamaño exacto
+    if (parser.total_vertices > 0)
+        parser.vertices = array_hold(NULL, parser.total_vertices, sizeof(vec3_t));
+    if (total_triangles > 0)
+        parser.faces = array_hold(NULL, total_triangles, sizeof(face_t));
+    parser.texcoords = (tex2_t *)malloc(sizeof(tex2_t) * (parser.total_texcoords + 1));
+    parser.face_texcoords = (int *)malloc(sizeof(int) * (total_triangles * 3 + 1));
+
+    run_parallel_jobs(parse_chunk_records, &parser, num_chunks);
+    run_parallel_jobs(resolve_chunk_texcoords, &parser, num_chunks);
+
+    // Quitamos los triángulos con índices que no existen conservando el orden
+    int num_invalid = 0;
+    for (int i = 0; i < num_chunks; i++)
+        num_invalid += parser.chunks[i].num_invalid;
+    if (num_invalid > 0)
+    {
+        int num_valid = 0;
+        for (int t = 0; t < total_triangles; t++)
+            if (parser.faces[t].a >= 0)
+                parser.faces[num_valid++] = parser.faces[t];
+        array_clear(parser.faces);
+        if (num_valid > 0)
+            array_hold(parser.faces, num_valid, sizeof(face_t));
+        printf("%s: skipped %d triangles with missing vertices\n", obj_filename, num_invalid);
+    }
+
+    *vertices = parser.vertices;
+    *faces = parser.faces;
+
+    free(parser.chunks);
+    free(parser.texcoords);
+    free(parser.face_texcoords);
+    unmap_file(&file);
+    return true;
+}
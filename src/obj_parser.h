@@ -0,0 +1,15 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "triangle.h"
+
+// Los trozos en que se reparte el fichero entre los hilos no bajan de este tamaño
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+// Trozos por hilo, con varios el reparto se equilibra aunque las líneas no cuesten igual
+#define OBJ_CHUNKS_PER_THREAD 4
+
+bool parse_obj_file(char *obj_filename, vec3_t **vertices, face_t **faces);
+
+#endif
@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "occlusion.h"
+#include "array.h"
+#include "clipping.h"
+#include "lod.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "transform.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Software occlusion culling
+///////////////////////////////////////////////////////////////////////////////
+// Antes de la etapa de geometría rasterizamos las mallas marcadas como
+// oclusoras (el suelo de la pista, cascos grandes...) en un buffer de
+// profundidad de baja resolución. Después proyectamos la caja de cada malla
+// y si su punto más cercano queda detrás de todo lo que hay en el buffer
+// dentro de su rectángulo en pantalla, la malla no se transforma ni se recorta.
+//
+// El buffer es conservador: un píxel solo se escribe si el triángulo lo cubre
+// entero y con la profundidad más lejana del triángulo dentro del píxel, así
+// que nunca queda más cerca que lo que el rasterizador dibujará después. Por
+// eso cada oclusor se rasteriza con el mismo nivel de detalle con el que se
+// dibuja: un nivel simplificado puede quedar por detrás de la malla completa
+///////////////////////////////////////////////////////////////////////////////
+static float *occlusion_buffer = NULL;
+static int occlusion_width = 0;
+static int occlusion_height = 0;
+
+static bool is_culling_enabled = true;
+
+void init_occlusion(int width, int height)
+{
+    occlusion_width = (width + OCCLUSION_SCALE - 1) / OCCLUSION_SCALE;
+    occlusion_height = (height + OCCLUSION_SCALE - 1) / OCCLUSION_SCALE;
+    occlusion_buffer = (float *)malloc(sizeof(float) * occlusion_width * occlusion_height);
+}
+
+void set_occlusion_culling(bool enabled)
+{
+    is_culling_enabled = enabled;
+}
+
+bool is_occlusion_culling(void)
+{
+    return is_culling_enabled;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rasterize a projected occluder triangle into the low resolution buffer
+///////////////////////////////////////////////////////////////////////////////
+static void rasterize_occluder_triangle(vec4_t points[3])
+{
+    // Pasamos los vértices a píxeles del buffer reducido
+    float x[3], y[3], reciprocal_w[3];
+    for (int i = 0; i < 3; i++)
+    {
+        x[i] = points[i].x / OCCLUSION_SCALE;
+        y[i] = points[i].y / OCCLUSION_SCALE;
+        reciprocal_w[i] = 1.0 / points[i].w;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (fabsf(area) < 0.0001f)
+        return;
+    float orientation = area > 0 ? 1.0 : -1.0;
+
+    // Función de arista opuesta a cada vértice, e(x,y) = a*x + b*y + c,
+    // positiva dentro del triángulo sea cual sea el orden de los vértices
+    float a[3], b[3], c[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3;
+        int k = (i + 2) % 3;
+        a[i] = -(y[k] - y[j]) * orientation;
+        b[i] = (x[k] - x[j]) * orientation;
+        c[i] = -(a[i] * x[j] + b[i] * y[j]);
+    }
+
+    // Plano de 1/w en el buffer reducido a partir de las coordenadas baricéntricas
+    float ddx = 0, ddy = 0, base = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        ddx += a[i] * reciprocal_w[i] / fabsf(area);
+        ddy += b[i] * reciprocal_w[i] / fabsf(area);
+        base += c[i] * reciprocal_w[i] / fabsf(area);
+    }
+
+    // Desde el centro, lo más lejos que llega el plano dentro del píxel
+    float depth_slope = 0.5 * (fabsf(ddx) + fabsf(ddy));
+
+    int min_x = (int)floorf(fminf(x[0], fminf(x[1], x[2])));
+    int min_y = (int)floorf(fminf(y[0], fminf(y[1], y[2])));
+    int max_x = (int)floorf(fmaxf(x[0], fmaxf(x[1], x[2])));
+    int max_y = (int)floorf(fmaxf(y[0], fmaxf(y[1], y[2])));
+    min_x = min_x < 0 ? 0 : min_x;
+    min_y = min_y < 0 ? 0 : min_y;
+    max_x = max_x >= occlusion_width ? occlusion_width - 1 : max_x;
+    max_y = max_y >= occlusion_height ? occlusion_height - 1 : max_y;
+
+    for (int py = min_y; py <= max_y; py++)
+    {
+        for (int px = min_x; px <= max_x; px++)
+        {
+            float center_x = px + 0.5;
+            float center_y = py + 0.5;
+
+            // El píxel está cubierto entero si su esquina más desfavorable
+            // queda dentro de las tres aristas
+            bool is_covered = true;
+            for (int i = 0; i < 3 && is_covered; i++)
+            {
+                float edge = a[i] * center_x + b[i] * center_y + c[i];
+                is_covered = edge >= 0.5 * (fabsf(a[i]) + fabsf(b[i]));
+            }
+            if (!is_covered)
+                continue;
+
+            // Guardamos la profundidad más lejana del triángulo dentro del píxel
+            float reciprocal_w_at = ddx * center_x + ddy * center_y + base - depth_slope;
+            float depth = 1.0 - reciprocal_w_at;
+            float *stored = &occlusion_buffer[(occlusion_width * py) + px];
+            if (depth < *stored)
+                *stored = depth;
+        }
+    }
+
+    add_stat(STAT_OCCLUDER_TRIANGLES, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rasterize the occluders among the given meshes, must run before testing any mesh
+///////////////////////////////////////////////////////////////////////////////
+void render_occluders(mesh_t **meshes, int num_meshes)
+{
+    mat4_t proj_matrix = get_projection_matrix();
+
+    for (int i = 0; i < occlusion_width * occlusion_height; i++)
+        occlusion_buffer[i] = 1.0;
+
+    // Los triángulos que salen del clipping se reutilizan cara a cara
+    triangle_t *triangles_after_clipping = (triangle_t *)arena_alloc(get_frame_arena(), sizeof(triangle_t) * MAX_NUM_POLY_TRIANGLES);
+
+    for (int mesh_index = 0; mesh_index < num_meshes; mesh_index++)
+    {
+        mesh_t *mesh = meshes[mesh_index];
+        if (!mesh->is_occluder || is_mesh_outside_frustum(mesh))
+            continue;
+
+        // La etapa de geometría vuelve a elegir el nivel con la misma cámara y obtiene el mismo
+        mesh_geometry_t *geometry = select_mesh_lod(mesh);
+        mat4_t model_view_matrix = mesh->transform.model_view_matrix;
+        int num_faces = array_length(geometry->faces);
+        for (int i = 0; i < num_faces; i++)
+        {
+            face_t mesh_face = geometry->faces[i];
+            vec4_t transformed_points[3] = {
+                mat4_mul_vec4(model_view_matrix, vec4_from_vec3(geometry->vertices[mesh_face.a])),
+                mat4_mul_vec4(model_view_matrix, vec4_from_vec3(geometry->vertices[mesh_face.b])),
+                mat4_mul_vec4(model_view_matrix, vec4_from_vec3(geometry->vertices[mesh_face.c])),
+            };
+
+            // Los outcodes descartan los triángulos de fuera y dicen contra qué planos recortar
+            int outcodes[3];
+            for (int j = 0; j < 3; j++)
+                outcodes[j] = get_vertex_outcode(vec3_from_vec4(transformed_points[j]));
+            if (outcodes[0] & outcodes[1] & outcodes[2] & FRUSTUM_OUTCODE_MASK)
+                continue;
+
+            // Las caras traseras siempre quedan detrás de alguna delantera (o no
+            // se dibujan), así que las saltamos aunque el backface culling esté apagado
+            vec3_t face_normal = get_triangle_normal(transformed_points);
+            vec3_t camera_ray = vec3_sub(vec3_new(0, 0, 0), vec3_from_vec4(transformed_points[0]));
+            if (vec3_dot(face_normal, camera_ray) < 0)
+                continue;
+
+            // Recortamos igual que la etapa de geometría, el buffer reducido hace de scissor
+            polygon_t polygon = polygon_from_triangle(
+                vec3_from_vec4(transformed_points[0]),
+                vec3_from_vec4(transformed_points[1]),
+                vec3_from_vec4(transformed_points[2]),
+                mesh_face.a_uv,
+                mesh_face.b_uv,
+                mesh_face.c_uv);
+            clip_polygon_against_planes(&polygon, get_clip_planes(outcodes[0] | outcodes[1] | outcodes[2]));
+
+            int num_triangles_after_clipping = 0;
+            triangles_from_polygon(&polygon, triangles_after_clipping, &num_triangles_after_clipping);
+
+            for (int t = 0; t < num_triangles_after_clipping; t++)
+            {
+                vec4_t projected_points[3];
+                for (int j = 0; j < 3; j++)
+                    projected_points[j] = project_to_screen(proj_matrix, triangles_after_clipping[t].points[j]);
+                rasterize_occluder_triangle(projected_points);
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Test the screen bounds of a mesh against the occluders
+///////////////////////////////////////////////////////////////////////////////
+bool is_mesh_occluded(mesh_t *mesh)
+{
+    mat4_t proj_matrix = get_projection_matrix();
+    mat4_t model_view_matrix = mesh->transform.model_view_matrix;
+
+    float min_x = FLT_MAX, min_y = FLT_MAX;
+    float max_x = -FLT_MAX, max_y = -FLT_MAX;
+    float nearest_z = FLT_MAX;
+
+    // Proyectamos las ocho esquinas de la caja local de la malla
+    for (int i = 0; i < 8; i++)
+    {
+        vec3_t corner = {
+            .x = (i & 1) ? mesh->geometry->bounds_max.x : mesh->geometry->bounds_min.x,
+            .y = (i & 2) ? mesh->geometry->bounds_max.y : mesh->geometry->bounds_min.y,
+            .z = (i & 4) ? mesh->geometry->bounds_max.z : mesh->geometry->bounds_min.z,
+        };
+        vec4_t camera_point = mat4_mul_vec4(model_view_matrix, vec4_from_vec3(corner));
+
+        // Si la caja cruza el plano near no podemos proyectarla, la damos por visible
+        if (!is_vertex_inside_plane(vec3_from_vec4(camera_point), NEAR_FRUSTUM_PLANE))
+            return false;
+
+        vec4_t screen_point = project_to_screen(proj_matrix, camera_point);
+        min_x = fminf(min_x, screen_point.x);
+        min_y = fminf(min_y, screen_point.y);
+        max_x = fmaxf(max_x, screen_point.x);
+        max_y = fmaxf(max_y, screen_point.y);
+        nearest_z = fminf(nearest_z, camera_point.z);
+    }
+
+    // Rectángulo de la caja en el buffer reducido, si cae fuera de la pantalla
+    // no decidimos nada (de eso se encarga el clipping)
+    int first_x = (int)floorf(min_x / OCCLUSION_SCALE);
+    int first_y = (int)floorf(min_y / OCCLUSION_SCALE);
+    int last_x = (int)floorf(max_x / OCCLUSION_SCALE);
+    int last_y = (int)floorf(max_y / OCCLUSION_SCALE);
+    first_x = first_x < 0 ? 0 : first_x;
+    first_y = first_y < 0 ? 0 : first_y;
+    last_x = last_x >= occlusion_width ? occlusion_width - 1 : last_x;
+    last_y = last_y >= occlusion_height ? occlusion_height - 1 : last_y;
+    if (first_x > last_x || first_y > last_y)
+        return false;
+
+    // La malla está oculta si su punto más cercano queda detrás de los oclusores en todo el rectángulo
+    float nearest_depth = 1.0 - 1.0 / nearest_z;
+    for (int y = first_y; y <= last_y; y++)
+        for (int x = first_x; x <= last_x; x++)
+            if (nearest_depth <= occlusion_buffer[(occlusion_width * y) + x] + OCCLUSION_EPSILON)
+                return false;
+
+    return true;
+}
+
+void free_occlusion(void)
+{
+    free(occlusion_buffer);
+}
@@ -0,0 +1,20 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdbool.h>
+#include "mesh.h"
+
+// Cada píxel del buffer de oclusión cubre OCCLUSION_SCALE x OCCLUSION_SCALE píxeles de pantalla
+#define OCCLUSION_SCALE 4
+
+// Margen para que los errores de redondeo nunca oculten una malla visible
+#define OCCLUSION_EPSILON 0.00001f
+
+void init_occlusion(int width, int height);
+void set_occlusion_culling(bool enabled);
+bool is_occlusion_culling(void);
+void render_occluders(mesh_t **meshes, int num_meshes);
+bool is_mesh_occluded(mesh_t *mesh);
+void free_occlusion(void);
+
+#endif
@@ -0,0 +1,647 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pipeline.h"
+#include "array.h"
+#include "display.h"
+#include "clipping.h"
+#include "clip_batch.h"
+#include "arena.h"
+#include "light.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "bvh.h"
+#include "lod.h"
+#include "transform.h"
+#include "simd.h"
+#include "sort.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-frame arena for everything that only lives until the next frame
+///////////////////////////////////////////////////////////////////////////////
+// Los triángulos a renderizar, sus setups, las claves de ordenación y la
+// memoria de trabajo del clipping salen de aquí. Se vacía al empezar cada
+// frame y crece a trozos grandes, sin límite de triángulos por frame
+static arena_t frame_arena;
+
+///////////////////////////////////////////////////////////////////////////////
+// Array to store triangles that should be rendered each frame
+///////////////////////////////////////////////////////////////////////////////
+static triangle_t *triangles_to_render = NULL;
+static int num_triangles_to_render = 0;
+
+// Setup de cada triángulo a renderizar (mismo índice), lo comparten todos los métodos de render
+static triangle_setup_t *triangle_setups = NULL;
+#define SETUP_JOB_SIZE 1024
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-frame buffer where every unique mesh vertex is transformed only once
+///////////////////////////////////////////////////////////////////////////////
+// Los vértices de todas las mallas van seguidos, cada malla empieza en un
+// desplazamiento múltiplo del ancho SIMD para que sus lotes queden alineados
+static transformed_vertex_t *transformed_vertices = NULL;
+static int transformed_vertices_capacity = 0;
+
+// Salida SoA de los kernels SIMD, en espacio de cámara
+static float *camera_x = NULL;
+static float *camera_y = NULL;
+static float *camera_z = NULL;
+static float *camera_w = NULL;
+
+static void reserve_transformed_vertices(int num_vertices)
+{
+    // El buffer solo crece, en estado estable se reutiliza frame a frame sin reservar memoria
+    if (num_vertices > transformed_vertices_capacity)
+    {
+        int padded_count = simd_padded_count(num_vertices);
+        transformed_vertices = realloc(transformed_vertices, sizeof(transformed_vertex_t) * padded_count);
+
+        simd_free(camera_x);
+        simd_free(camera_y);
+        simd_free(camera_z);
+        simd_free(camera_w);
+        camera_x = simd_alloc(sizeof(float) * padded_count);
+        camera_y = simd_alloc(sizeof(float) * padded_count);
+        camera_z = simd_alloc(sizeof(float) * padded_count);
+        camera_w = simd_alloc(sizeof(float) * padded_count);
+
+        transformed_vertices_capacity = padded_count;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Jobs of the geometry stage that can run in parallel
+///////////////////////////////////////////////////////////////////////////////
+// El tamaño de los lotes de vértices debe ser múltiplo de SIMD_WIDTH
+#define VERTEX_JOB_SIZE 2048
+#define FACE_JOB_SIZE 512
+
+typedef struct geometry_job_t
+{
+    mesh_t *mesh;
+    mesh_geometry_t *geometry; // nivel de detalle de la malla elegido para este frame
+    int vertex_offset;     // inicio de los vértices de la malla en el buffer del frame
+    int begin;             // primer vértice o cara del lote
+    int end;               // último vértice o cara del lote (no incluido)
+    triangle_t *triangles; // lista de salida propia del trabajo, se conserva entre frames
+    clip_batch_t *clip_batch; // memoria de trabajo del clipping, sale de la arena del frame
+} geometry_job_t;
+
+static geometry_job_t *vertex_jobs = NULL;
+static int num_vertex_jobs = 0;
+static int vertex_jobs_capacity = 0;
+
+static geometry_job_t *face_jobs = NULL;
+static int num_face_jobs = 0;
+static int face_jobs_capacity = 0;
+
+// Matriz de proyección del frame actual, todos los hilos la leen
+static mat4_t proj_matrix;
+
+static geometry_job_t *add_job(geometry_job_t **jobs, int *num_jobs, int *capacity)
+{
+    if (*num_jobs == *capacity)
+    {
+        int new_capacity = *capacity ? *capacity * 2 : 64;
+        *jobs = realloc(*jobs, sizeof(geometry_job_t) * new_capacity);
+        for (int i = *capacity; i < new_capacity; i++)
+            (*jobs)[i].triangles = NULL;
+        *capacity = new_capacity;
+    }
+    // Conservamos la lista de triángulos del frame anterior para reutilizar su memoria
+    geometry_job_t *job = &(*jobs)[(*num_jobs)++];
+    array_clear(job->triangles);
+    return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Project a camera space point into screen space
+///////////////////////////////////////////////////////////////////////////////
+vec4_t project_to_screen(mat4_t proj_matrix, vec4_t point)
+{
+    // Proyectamos el vértice
+    return clip_to_screen(mat4_mul_vec4(proj_matrix, point));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Map a clip space point (already projected) into screen space
+///////////////////////////////////////////////////////////////////////////////
+vec4_t clip_to_screen(vec4_t projected_point)
+{
+    // Ejecutamos la división de la perspectiva
+    if (projected_point.w != 0)
+    {
+        projected_point.x /= projected_point.w;
+        projected_point.y /= projected_point.w;
+        projected_point.z /= projected_point.w;
+    }
+
+    // Invertimos los valores 'y' debido a los valores invertidos de la pantalla
+    // Figura 34 valores invertidos.png
+    projected_point.y *= -1;
+
+    // Escalamos en la vista
+    projected_point.x *= (get_window_width() / 2.0);
+    projected_point.y *= (get_window_height() / 2.0);
+
+    // Trasladamos los puntos proyectados al centro de la pantalla
+    projected_point.x += (get_window_width() / 2.0);
+    projected_point.y += (get_window_height() / 2.0);
+
+    return projected_point;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Store a projected triangle in the output list of the job
+///////////////////////////////////////////////////////////////////////////////
+static void add_triangle_to_render(geometry_job_t *job, vec4_t projected_points[3], tex2_t texcoords[3], uint32_t color, texture_t *texture)
+{
+    triangle_t triangle_to_render = {
+        .points = {
+            {projected_points[0].x, projected_points[0].y, projected_points[0].z, projected_points[0].w},
+            {projected_points[1].x, projected_points[1].y, projected_points[1].z, projected_points[1].w},
+            {projected_points[2].x, projected_points[2].y, projected_points[2].z, projected_points[2].w},
+        },
+        .texcoords = {
+            {texcoords[0].u, texcoords[0].v},
+            {texcoords[1].u, texcoords[1].v},
+            {texcoords[2].u, texcoords[2].v},
+        },
+        .color = color,
+        .texture = texture,
+    };
+
+    // Cada trabajo escribe en su propia lista, así los hilos no necesitan bloqueos
+    array_push(job->triangles, triangle_to_render);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Transform a batch of mesh vertices into camera and screen space
+///////////////////////////////////////////////////////////////////////////////
+static void process_vertex_job(void *data, int job_index, int thread_index)
+{
+    geometry_job_t *job = &vertex_jobs[job_index];
+    mesh_t *mesh = job->mesh;
+    mesh_geometry_t *geometry = job->geometry;
+    mat4_t model_view_matrix = mesh->transform.model_view_matrix;
+    int first = job->vertex_offset + job->begin;
+
+    // Si la malla tiene sus posiciones en SoA las transformamos en lotes de 4/8 con SIMD
+    bool has_soa_positions = geometry->positions_x != NULL;
+    if (has_soa_positions)
+    {
+        mat4_mul_vec3_soa(
+            model_view_matrix,
+            &geometry->positions_x[job->begin], &geometry->positions_y[job->begin], &geometry->positions_z[job->begin],
+            &camera_x[first], &camera_y[first], &camera_z[first], &camera_w[first],
+            simd_padded_count(job->end - job->begin));
+    }
+
+    for (int i = job->begin; i < job->end; i++)
+    {
+        transformed_vertex_t *vertex = &transformed_vertices[job->vertex_offset + i];
+
+        // Multiplicamos la matriz model-view (mundo y vista combinadas) por el vector original
+        // del vértice para transformarlo directamente al espacio de la cámara
+        if (has_soa_positions)
+        {
+            int k = job->vertex_offset + i;
+            vertex->camera_point = (vec4_t){camera_x[k], camera_y[k], camera_z[k], camera_w[k]};
+        }
+        else
+            vertex->camera_point = mat4_mul_vec4(model_view_matrix, vec4_from_vec3(geometry->vertices[i]));
+
+        // Calculamos su outcode una sola vez, todas las caras que lo comparten lo reutilizan,
+        // y si el vértice no va a ser recortado ya podemos dejarlo proyectado en pantalla
+        vertex->outcode = get_vertex_outcode(vec3_from_vec4(vertex->camera_point));
+        if (get_clip_planes(vertex->outcode) == 0)
+            vertex->screen_point = project_to_screen(proj_matrix, vertex->camera_point);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clip the pending triangles of a job at once and store the resulting ones
+///////////////////////////////////////////////////////////////////////////////
+static void flush_clip_batch(geometry_job_t *job, clip_batch_t *batch, uint32_t colors[])
+{
+    run_clip_batch(batch);
+
+    for (int lane = 0; lane < batch->count; lane++)
+    {
+        // Después del clipping rompemos cada polígono en un abanico de triángulos
+        int num_vertices = get_clip_batch_num_vertices(batch, lane);
+        vec4_t clip_points[MAX_NUM_POLY_VERTICES];
+        tex2_t texcoords[MAX_NUM_POLY_VERTICES];
+        for (int i = 0; i < num_vertices; i++)
+            get_clip_batch_vertex(batch, lane, i, &clip_points[i], &texcoords[i]);
+
+        for (int i = 0; i < num_vertices - 2; i++)
+        {
+            // Los vértices ya están proyectados, solo falta la división y el viewport
+            vec4_t projected_points[3] = {
+                clip_to_screen(clip_points[0]),
+                clip_to_screen(clip_points[i + 1]),
+                clip_to_screen(clip_points[i + 2]),
+            };
+            tex2_t triangle_texcoords[3] = {texcoords[0], texcoords[i + 1], texcoords[i + 2]};
+
+            add_triangle_to_render(job, projected_points, triangle_texcoords, colors[lane], job->mesh->texture);
+        }
+    }
+
+    clear_clip_batch(batch);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Cull, clip and project a batch of mesh faces
+///////////////////////////////////////////////////////////////////////////////
+static void process_face_job(void *data, int job_index, int thread_index)
+{
+    geometry_job_t *job = &face_jobs[job_index];
+    mesh_t *mesh = job->mesh;
+    int rejected_triangles = 0;
+    int clipped_triangles = 0;
+
+    // Los triángulos que hay que recortar se acumulan y se recortan de ocho en ocho
+    clip_batch_t *clip_batch = job->clip_batch;
+    uint32_t clip_batch_colors[CLIP_BATCH_SIZE];
+    init_clip_batch(clip_batch);
+
+    // Iteramos las caras del lote, solo son índices a los vértices transformados
+    for (int i = job->begin; i < job->end; i++)
+    {
+        face_t mesh_face = job->geometry->faces[i];
+
+        transformed_vertex_t *face_vertices[3] = {
+            &transformed_vertices[job->vertex_offset + mesh_face.a],
+            &transformed_vertices[job->vertex_offset + mesh_face.b],
+            &transformed_vertices[job->vertex_offset + mesh_face.c],
+        };
+
+        // Si los tres vértices quedan fuera del mismo plano del frustum el triángulo
+        // entero está fuera, lo descartamos antes de calcular nada más
+        int outcode_and = face_vertices[0]->outcode & face_vertices[1]->outcode & face_vertices[2]->outcode;
+        int outcode_or = face_vertices[0]->outcode | face_vertices[1]->outcode | face_vertices[2]->outcode;
+        if (outcode_and & FRUSTUM_OUTCODE_MASK)
+        {
+            rejected_triangles++;
+            continue;
+        }
+
+        vec4_t transformed_points[3] = {
+            face_vertices[0]->camera_point,
+            face_vertices[1]->camera_point,
+            face_vertices[2]->camera_point,
+        };
+
+        // Calculamos la normal de los triángulos
+        vec3_t face_normal = get_triangle_normal(transformed_points);
+
+        // Si el triángulo no está alineado con la cámara saltamos la iteración
+        if (is_cull_backface())
+        {
+            // Buscamos el vector entre un punto del trángulo y el origen de la cámara
+            // Figura "docs/15 camera raycast.png"
+            vec3_t camera_ray = vec3_sub(vec3_new(0, 0, 0), vec3_from_vec4(transformed_points[0]));
+
+            // Calculamos cuán alineado está el camera_ray respecto al vector normal
+            // Utilizando para ello el producto escalar (el orden de los vectores no importa)
+            float dot_normal_camera = vec3_dot(face_normal, camera_ray);
+
+            // Backface culling, bypassing triangles that are looking away from the camera
+            if (dot_normal_camera < 0)
+                continue;
+        }
+
+        // Calculamos la intensidad del sombreado basándonos en cuán alineados están la normal de la cara del triángulo y la inversa de la luz (lo negamos por lo de que la profundidad va hacia dentro en nuestro modelo, y en cambio la luz se refleja hacia fuera a nuestra cámara, por eso si no lo negamos se nos oscurece al revés)
+        float light_intensity_factor = -vec3_dot(face_normal, get_light_direction());
+
+        // Calculamos el color del triángulo basados en el ángulo de la luz
+        uint32_t triangle_color = light_apply_intensity(mesh_face.color, light_intensity_factor);
+
+        // Si ningún vértice cruza un plano que haya que recortar (con la guard band solo
+        // near, far y los lados de la propia guard band) el triángulo no se recorta
+        // y reutilizamos directamente sus posiciones ya proyectadas en pantalla
+        int clip_planes = get_clip_planes(outcode_or);
+        if (clip_planes == 0)
+        {
+            vec4_t projected_points[3] = {
+                face_vertices[0]->screen_point,
+                face_vertices[1]->screen_point,
+                face_vertices[2]->screen_point,
+            };
+            tex2_t texcoords[3] = {mesh_face.a_uv, mesh_face.b_uv, mesh_face.c_uv};
+
+            add_triangle_to_render(job, projected_points, texcoords, triangle_color, mesh->texture);
+            continue;
+        }
+
+        // Clipping!!
+        // Proyectamos el triángulo a espacio de recorte (homogéneo) y lo añadimos al lote,
+        // se recortará solo contra los planos que cruza cuando el lote esté lleno
+        vec4_t clip_points[3] = {
+            mat4_mul_vec4(proj_matrix, transformed_points[0]),
+            mat4_mul_vec4(proj_matrix, transformed_points[1]),
+            mat4_mul_vec4(proj_matrix, transformed_points[2]),
+        };
+        tex2_t texcoords[3] = {mesh_face.a_uv, mesh_face.b_uv, mesh_face.c_uv};
+
+        int lane = add_to_clip_batch(clip_batch, clip_points, texcoords, clip_planes);
+        clip_batch_colors[lane] = triangle_color;
+        if (clip_batch->count == CLIP_BATCH_SIZE)
+            flush_clip_batch(job, clip_batch, clip_batch_colors);
+        clipped_triangles++;
+    }
+
+    if (clip_batch->count > 0)
+        flush_clip_batch(job, clip_batch, clip_batch_colors);
+
+    add_stat(STAT_REJECTED_TRIANGLES, rejected_triangles);
+    add_stat(STAT_CLIPPED_TRIANGLES, clipped_triangles);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Put the instances of the same geometry next to each other
+///////////////////////////////////////////////////////////////////////////////
+// Así los trabajos seguidos leen los mismos vértices y caras, que siguen en
+// caché de una instancia a la siguiente. La ordenación es estable, dentro de
+// cada geometría se conserva el orden de la jerarquía de la escena
+///////////////////////////////////////////////////////////////////////////////
+static mesh_t **group_meshes_by_geometry(mesh_t **meshes, int num_meshes)
+{
+    uint32_t *keys = (uint32_t *)arena_alloc(&frame_arena, sizeof(uint32_t) * num_meshes);
+    int *order = (int *)arena_alloc(&frame_arena, sizeof(int) * num_meshes);
+    for (int i = 0; i < num_meshes; i++)
+    {
+        keys[i] = meshes[i]->geometry->id;
+        order[i] = i;
+    }
+
+    radix_sort(keys, order, num_meshes);
+
+    mesh_t **grouped_meshes = (mesh_t **)arena_alloc(&frame_arena, sizeof(mesh_t *) * num_meshes);
+    for (int i = 0; i < num_meshes; i++)
+        grouped_meshes[i] = meshes[order[i]];
+    return grouped_meshes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Process the graphics pipeline stages for all the mesh triangles
+///////////////////////////////////////////////////////////////////////////////
+// +-------------+
+// | Model space |  <-- original mesh vertices
+// +-------------+
+// |   +-------------+
+// `-> | World space |  <-- multiply by world matrix
+//     +-------------+
+//     |   +--------------+
+//     `-> | Camera space |  <-- multiply by view matrix
+//         +--------------+
+//         |    +------------+
+//         `--> |  Clipping  |  <-- clip against the six frustum planes
+//              +------------+
+//              |    +------------+
+//              `--> | Projection |  <-- multiply by projection matrix
+//                   +------------+
+//                   |    +-------------+
+//                   `--> | Image space |  <-- apply perspective divide
+//                        +-------------+
+//                        |    +--------------+
+//                        `--> | Screen space |  <-- ready to render
+//                             +--------------+
+///////////////////////////////////////////////////////////////////////////////
+void process_graphics_pipeline_stages(void)
+{
+    proj_matrix = get_projection_matrix();
+    num_vertex_jobs = 0;
+    num_face_jobs = 0;
+
+    // Las mallas que se han movido recalculan su matriz de mundo y sus cajas y
+    // reajustan la jerarquía de la escena, las demás no se tocan
+    update_scene_bvh();
+
+    // Recorremos la jerarquía contra el frustum, las ramas enteras fuera no se visitan
+    mesh_t **candidate_meshes;
+    int num_candidate_meshes = cull_scene_bvh(&candidate_meshes);
+    add_stat(STAT_CULLED_MESHES, get_num_meshes() - num_candidate_meshes);
+    candidate_meshes = group_meshes_by_geometry(candidate_meshes, num_candidate_meshes);
+
+    // La model-view está cacheada, solo se recalcula si la cámara ha cambiado
+    for (int mesh_index = 0; mesh_index < num_candidate_meshes; mesh_index++)
+        update_mesh_transform(candidate_meshes[mesh_index]);
+
+    // Los oclusores se rasterizan primero en el buffer reducido para poder
+    // descartar las mallas ocultas antes de transformar ninguno de sus vértices
+    if (is_occlusion_culling())
+        render_occluders(candidate_meshes, num_candidate_meshes);
+
+    // Repartimos los vértices y las caras de todas las mallas en lotes independientes
+    int total_vertices = 0;
+    for (int mesh_index = 0; mesh_index < num_candidate_meshes; mesh_index++)
+    {
+        mesh_t *mesh = candidate_meshes[mesh_index];
+
+        // Las hojas que cruzan algún plano se prueban con la esfera y la caja de la malla
+        if (is_mesh_outside_frustum(mesh))
+        {
+            add_stat(STAT_CULLED_MESHES, 1);
+            continue;
+        }
+
+        if (is_occlusion_culling() && is_mesh_occluded(mesh))
+        {
+            add_stat(STAT_OCCLUDED_MESHES, 1);
+            continue;
+        }
+        add_stat(STAT_VISIBLE_MESHES, 1);
+
+        // Las mallas pequeñas en pantalla usan un nivel simplificado
+        mesh_geometry_t *geometry = select_mesh_lod(mesh);
+        add_stat(STAT_LOD_SKIPPED_FACES, array_length(mesh->geometry->faces) - array_length(geometry->faces));
+
+        int num_vertices = array_length(geometry->vertices);
+        for (int begin = 0; begin < num_vertices; begin += VERTEX_JOB_SIZE)
+        {
+            geometry_job_t *job = add_job(&vertex_jobs, &num_vertex_jobs, &vertex_jobs_capacity);
+            job->mesh = mesh;
+            job->geometry = geometry;
+            job->vertex_offset = total_vertices;
+            job->begin = begin;
+            job->end = begin + VERTEX_JOB_SIZE < num_vertices ? begin + VERTEX_JOB_SIZE : num_vertices;
+        }
+
+        int num_faces = array_length(geometry->faces);
+        for (int begin = 0; begin < num_faces; begin += FACE_JOB_SIZE)
+        {
+            geometry_job_t *job = add_job(&face_jobs, &num_face_jobs, &face_jobs_capacity);
+            job->mesh = mesh;
+            job->geometry = geometry;
+            job->vertex_offset = total_vertices;
+            job->begin = begin;
+            job->end = begin + FACE_JOB_SIZE < num_faces ? begin + FACE_JOB_SIZE : num_faces;
+
+            // Reservamos sitio para un triángulo por cara antes de lanzar los hilos, así en un frame
+            // normal los trabajos no tocan el heap y solo crecen si el clipping genera más triángulos
+            // (la capacidad se queda para los frames siguientes)
+            job->triangles = array_hold(job->triangles, job->end - job->begin, sizeof(triangle_t));
+            array_clear(job->triangles);
+            job->clip_batch = (clip_batch_t *)arena_alloc(&frame_arena, sizeof(clip_batch_t));
+        }
+
+        total_vertices += simd_padded_count(num_vertices);
+    }
+    reserve_transformed_vertices(total_vertices);
+
+    // TRANSFORMACIONES: Cada vértice único se transforma una sola vez, las caras lo
+    // reutilizan a través de su índice, así que las caras esperan a todos los vértices
+    run_parallel_jobs(process_vertex_job, NULL, num_vertex_jobs);
+    run_parallel_jobs(process_face_job, NULL, num_face_jobs);
+
+    // Juntamos las listas de cada trabajo en el orden en que se crearon (malla a malla
+    // y cara a cara), el resultado es idéntico al del camino con un solo hilo
+    num_triangles_to_render = 0;
+    for (int j = 0; j < num_face_jobs; j++)
+        num_triangles_to_render += array_length(face_jobs[j].triangles);
+
+    triangles_to_render = (triangle_t *)arena_alloc(&frame_arena, sizeof(triangle_t) * num_triangles_to_render);
+    int offset = 0;
+    for (int j = 0; j < num_face_jobs; j++)
+    {
+        geometry_job_t *job = &face_jobs[j];
+        int num_triangles = array_length(job->triangles);
+        memcpy(&triangles_to_render[offset], job->triangles, sizeof(triangle_t) * num_triangles);
+        offset += num_triangles;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Optional front-to-back ordering of the triangles to render
+///////////////////////////////////////////////////////////////////////////////
+// La clave de cada triángulo lleva en los bits altos la profundidad de su
+// vértice más cercano y en los bajos un identificador de su textura, así los
+// triángulos cercanos se dibujan primero (el test de profundidad y el Hi-Z
+// descartan más píxeles de los que vienen detrás). La profundidad va en pocos
+// bits: dentro de cada franja los triángulos de la misma textura quedan seguidos.
+// Como 1 - 1/w se comprime hacia el fondo, las franjas cercanas son estrechas y
+// las lejanas abarcan mucho, que es donde el orden importa menos
+///////////////////////////////////////////////////////////////////////////////
+#define SORT_DEPTH_BITS 6
+#define SORT_TEXTURE_BITS 12
+#define MAX_SORT_TEXTURES (1 << SORT_TEXTURE_BITS)
+
+// El 0 es para los triángulos sin textura, si hay más texturas de las que
+// caben en la clave comparten el último identificador
+static uint32_t get_sort_texture_id(texture_t *texture)
+{
+    if (texture == NULL)
+        return 0;
+    return texture->id + 1 < MAX_SORT_TEXTURES ? texture->id + 1 : MAX_SORT_TEXTURES - 1;
+}
+
+void sort_triangles_to_render(void)
+{
+    Uint64 start_time = SDL_GetPerformanceCounter();
+
+    uint32_t *sort_keys = (uint32_t *)arena_alloc(&frame_arena, sizeof(uint32_t) * num_triangles_to_render);
+    int *sort_order = (int *)arena_alloc(&frame_arena, sizeof(int) * num_triangles_to_render);
+    triangle_t *sorted_triangles = (triangle_t *)arena_alloc(&frame_arena, sizeof(triangle_t) * num_triangles_to_render);
+
+    for (int i = 0; i < num_triangles_to_render; i++)
+    {
+        triangle_t *triangle = &triangles_to_render[i];
+
+        // Profundidad del vértice más cercano, la misma que guarda el z-buffer (1 - 1/w)
+        float nearest_reciprocal_w = 0;
+        for (int j = 0; j < 3; j++)
+            if (1.0 / triangle->points[j].w > nearest_reciprocal_w)
+                nearest_reciprocal_w = 1.0 / triangle->points[j].w;
+        float depth = 1.0 - nearest_reciprocal_w;
+        depth = depth < 0 ? 0 : (depth > 1 ? 1 : depth);
+
+        uint32_t quantized_depth = (uint32_t)(depth * ((1 << SORT_DEPTH_BITS) - 1));
+        sort_keys[i] = (quantized_depth << SORT_TEXTURE_BITS) | get_sort_texture_id(triangle->texture);
+        sort_order[i] = i;
+    }
+
+    radix_sort(sort_keys, sort_order, num_triangles_to_render);
+
+    // La lista desordenada se queda en la arena hasta el siguiente frame, basta con cambiar el puntero
+    for (int i = 0; i < num_triangles_to_render; i++)
+        sorted_triangles[i] = triangles_to_render[sort_order[i]];
+    triangles_to_render = sorted_triangles;
+
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start_time;
+    add_stat(STAT_SORT_MICROSECONDS, (int)(elapsed * 1000000 / SDL_GetPerformanceFrequency()));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Triangle setup: attribute planes computed once per triangle before rasterizing
+///////////////////////////////////////////////////////////////////////////////
+static void process_setup_job(void *data, int job_index, int thread_index)
+{
+    int begin = job_index * SETUP_JOB_SIZE;
+    int end = begin + SETUP_JOB_SIZE < num_triangles_to_render ? begin + SETUP_JOB_SIZE : num_triangles_to_render;
+    for (int i = begin; i < end; i++)
+        setup_triangle(&triangles_to_render[i], &triangle_setups[i]);
+}
+
+void setup_triangles_to_render(void)
+{
+    triangle_setups = (triangle_setup_t *)arena_alloc(&frame_arena, sizeof(triangle_setup_t) * num_triangles_to_render);
+
+    int num_jobs = (num_triangles_to_render + SETUP_JOB_SIZE - 1) / SETUP_JOB_SIZE;
+    run_parallel_jobs(process_setup_job, NULL, num_jobs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Release everything allocated during the previous frame at once
+///////////////////////////////////////////////////////////////////////////////
+void reset_frame_arena(void)
+{
+    reset_arena(&frame_arena);
+    num_triangles_to_render = 0;
+}
+
+arena_t *get_frame_arena(void)
+{
+    return &frame_arena;
+}
+
+void add_frame_arena_stats(void)
+{
+    add_stat(STAT_ARENA_KILOBYTES, (int)(get_arena_used(&frame_arena) / 1024));
+    add_stat(STAT_ARENA_HIGH_WATER_KILOBYTES, (int)(get_arena_high_water_mark(&frame_arena) / 1024));
+}
+
+triangle_setup_t *get_triangle_setups(void)
+{
+    return triangle_setups;
+}
+
+triangle_t *get_triangles_to_render(void)
+{
+    return triangles_to_render;
+}
+
+int get_num_triangles_to_render(void)
+{
+    return num_triangles_to_render;
+}
+
+void free_pipeline(void)
+{
+    for (int i = 0; i < face_jobs_capacity; i++)
+        array_free(face_jobs[i].triangles);
+    free(face_jobs);
+    free(vertex_jobs);
+
+    free(transformed_vertices);
+    simd_free(camera_x);
+    simd_free(camera_y);
+    simd_free(camera_z);
+    simd_free(camera_w);
+
+    free_sort();
+    free_arena(&frame_arena);
+}
@@ -0,0 +1,26 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "vector.h"
+#include "matrix.h"
+#include "triangle.h"
+#include "arena.h"
+
+void process_graphics_pipeline_stages(void);
+void sort_triangles_to_render(void);
+void setup_triangles_to_render(void);
+
+triangle_t *get_triangles_to_render(void);
+int get_num_triangles_to_render(void);
+triangle_setup_t *get_triangle_setups(void);
+
+void reset_frame_arena(void);
+arena_t *get_frame_arena(void);
+void add_frame_arena_stats(void);
+
+vec4_t project_to_screen(mat4_t proj_matrix, vec4_t point);
+vec4_t clip_to_screen(vec4_t projected_point);
+
+void free_pipeline(void);
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "simd.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+static int simd_level = SIMD_SCALAR;
+static int simd_supported_level = SIMD_SCALAR;
+
+///////////////////////////////////////////////////////////////////////////////
+// Detect the widest instruction set available on this CPU
+///////////////////////////////////////////////////////////////////////////////
+void init_simd(void)
+{
+    simd_supported_level = SIMD_SCALAR;
+#ifdef SIMD_X86
+    if (SDL_HasSSE2())
+        simd_supported_level = SIMD_SSE2;
+    if (SDL_HasAVX2())
+        simd_supported_level = SIMD_AVX2;
+#endif
+    simd_level = simd_supported_level;
+}
+
+int get_simd_level(void)
+{
+    return simd_level;
+}
+
+// Permite forzar un nivel inferior para comparar rendimiento (A/B)
+void set_simd_level(int level)
+{
+    simd_level = level > simd_supported_level ? simd_supported_level : level;
+}
+
+int simd_padded_count(int count)
+{
+    return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+// Reservamos de más y guardamos el puntero original justo antes del bloque alineado
+void *simd_alloc(int size)
+{
+    void *raw = malloc(size + SIMD_ALIGNMENT + sizeof(void *));
+    if (raw == NULL)
+        return NULL;
+    uintptr_t aligned = ((uintptr_t)raw + sizeof(void *) + SIMD_ALIGNMENT - 1) & ~(uintptr_t)(SIMD_ALIGNMENT - 1);
+    ((void **)aligned)[-1] = raw;
+    return (void *)aligned;
+}
+
+void simd_free(void *ptr)
+{
+    if (ptr != NULL)
+        free(((void **)ptr)[-1]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Batch vertex transform kernels
+///////////////////////////////////////////////////////////////////////////////
+// Todas las versiones suman en el mismo orden que mat4_mul_vec4 (sin FMA),
+// así el resultado es idéntico bit a bit al del camino escalar
+///////////////////////////////////////////////////////////////////////////////
+static void mat4_mul_vec3_soa_scalar(
+    mat4_t m, const float *x, const float *y, const float *z,
+    float *out_x, float *out_y, float *out_z, float *out_w, int begin, int count)
+{
+    for (int i = begin; i < count; i++)
+    {
+        out_x[i] = m.m[0][0] * x[i] + m.m[0][1] * y[i] + m.m[0][2] * z[i] + m.m[0][3];
+        out_y[i] = m.m[1][0] * x[i] + m.m[1][1] * y[i] + m.m[1][2] * z[i] + m.m[1][3];
+        out_z[i] = m.m[2][0] * x[i] + m.m[2][1] * y[i] + m.m[2][2] * z[i] + m.m[2][3];
+        out_w[i] = m.m[3][0] * x[i] + m.m[3][1] * y[i] + m.m[3][2] * z[i] + m.m[3][3];
+    }
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2"))) static int mat4_mul_vec3_soa_sse2(
+    mat4_t m, const float *x, const float *y, const float *z,
+    float *out_x, float *out_y, float *out_z, float *out_w, int count)
+{
+    float *out[4] = {out_x, out_y, out_z, out_w};
+    int i = 0;
+
+    // 4 vértices por instrucción
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 vx = _mm_load_ps(&x[i]);
+        __m128 vy = _mm_load_ps(&y[i]);
+        __m128 vz = _mm_load_ps(&z[i]);
+        for (int row = 0; row < 4; row++)
+        {
+            __m128 r = _mm_mul_ps(_mm_set1_ps(m.m[row][0]), vx);
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m.m[row][1]), vy));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m.m[row][2]), vz));
+            r = _mm_add_ps(r, _mm_set1_ps(m.m[row][3]));
+            _mm_store_ps(&out[row][i], r);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static int mat4_mul_vec3_soa_avx2(
+    mat4_t m, const float *x, const float *y, const float *z,
+    float *out_x, float *out_y, float *out_z, float *out_w, int count)
+{
+    float *out[4] = {out_x, out_y, out_z, out_w};
+    int i = 0;
+
+    // 8 vértices por instrucción
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 vx = _mm256_load_ps(&x[i]);
+        __m256 vy = _mm256_load_ps(&y[i]);
+        __m256 vz = _mm256_load_ps(&z[i]);
+        for (int row = 0; row < 4; row++)
+        {
+            __m256 r = _mm256_mul_ps(_mm256_set1_ps(m.m[row][0]), vx);
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(m.m[row][1]), vy));
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(m.m[row][2]), vz));
+            r = _mm256_add_ps(r, _mm256_set1_ps(m.m[row][3]));
+            _mm256_store_ps(&out[row][i], r);
+        }
+    }
+    return i;
+}
+#endif
+
+void mat4_mul_vec3_soa(
+    mat4_t m,
+    const float *x, const float *y, const float *z,
+    float *out_x, float *out_y, float *out_z, float *out_w,
+    int count)
+{
+    int done = 0;
+#ifdef SIMD_X86
+    if (simd_level == SIMD_AVX2)
+        done = mat4_mul_vec3_soa_avx2(m, x, y, z, out_x, out_y, out_z, out_w, count);
+    else if (simd_level == SIMD_SSE2)
+        done = mat4_mul_vec3_soa_sse2(m, x, y, z, out_x, out_y, out_z, out_w, count);
+#endif
+    // Los vértices sobrantes (si count no es múltiplo del ancho) van por el camino escalar
+    mat4_mul_vec3_soa_scalar(m, x, y, z, out_x, out_y, out_z, out_w, done, count);
+}
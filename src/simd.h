@@ -0,0 +1,42 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdbool.h>
+#include "matrix.h"
+
+// Las instrucciones SSE2/AVX2 solo están disponibles en x86 con GCC/MinGW
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#endif
+
+// Número máximo de floats que procesamos a la vez (un registro AVX2 de 256 bits)
+#define SIMD_WIDTH 8
+
+// Alineación de los arrays SoA para poder usar cargas alineadas de 256 bits
+#define SIMD_ALIGNMENT 32
+
+enum simd_level
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+void init_simd(void);
+int get_simd_level(void);
+void set_simd_level(int level);
+
+// Memoria alineada para arrays SoA, el tamaño se rellena hasta múltiplos de SIMD_WIDTH
+int simd_padded_count(int count);
+void *simd_alloc(int size);
+void simd_free(void *ptr);
+
+// Transforma 'count' posiciones (x, y, z, 1) en formato SoA por la matriz m
+// El resultado se escribe también en SoA, por ejemplo en espacio de recorte con la MVP
+void mat4_mul_vec3_soa(
+    mat4_t m,
+    const float *x, const float *y, const float *z,
+    float *out_x, float *out_y, float *out_z, float *out_w,
+    int count);
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sort.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// LSD radix sort of 32 bit keys, one byte per pass
+///////////////////////////////////////////////////////////////////////////////
+// Cada pasada reparte las claves por uno de sus bytes (del menos al más
+// significativo) usando un histograma, y como el reparto es estable el
+// resultado queda ordenado por la clave completa tras las cuatro pasadas.
+// Las pasadas en las que todas las claves comparten el byte no cambian el
+// orden, así que nos las saltamos (pasa mucho con claves de pocos bits)
+///////////////////////////////////////////////////////////////////////////////
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES (32 / RADIX_BITS)
+
+// Buffers auxiliares para alternar entre pasadas, solo crecen
+static uint32_t *scratch_keys = NULL;
+static int *scratch_values = NULL;
+static int scratch_capacity = 0;
+
+void radix_sort(uint32_t *keys, int *values, int count)
+{
+    if (count > scratch_capacity)
+    {
+        scratch_keys = realloc(scratch_keys, sizeof(uint32_t) * count);
+        scratch_values = realloc(scratch_values, sizeof(int) * count);
+        scratch_capacity = count;
+    }
+
+    // Histogramas de todas las pasadas en un solo recorrido
+    int histograms[RADIX_PASSES][RADIX_SIZE];
+    memset(histograms, 0, sizeof(histograms));
+    for (int i = 0; i < count; i++)
+        for (int pass = 0; pass < RADIX_PASSES; pass++)
+            histograms[pass][(keys[i] >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+
+    uint32_t *source_keys = keys;
+    int *source_values = values;
+    uint32_t *target_keys = scratch_keys;
+    int *target_values = scratch_values;
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++)
+    {
+        int *histogram = histograms[pass];
+        int shift = pass * RADIX_BITS;
+        if (count == 0 || histogram[(source_keys[0] >> shift) & (RADIX_SIZE - 1)] == count)
+            continue;
+
+        // Convertimos el histograma en la posición de salida de cada dígito
+        int offset = 0;
+        for (int digit = 0; digit < RADIX_SIZE; digit++)
+        {
+            int digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int position = histogram[(source_keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+            target_keys[position] = source_keys[i];
+            target_values[position] = source_values[i];
+        }
+
+        uint32_t *swap_keys = source_keys;
+        int *swap_values = source_values;
+        source_keys = target_keys;
+        source_values = target_values;
+        target_keys = swap_keys;
+        target_values = swap_values;
+    }
+
+    // Si el resultado ha quedado en los buffers auxiliares lo copiamos de vuelta
+    if (source_keys != keys)
+    {
+        memcpy(keys, source_keys, sizeof(uint32_t) * count);
+        memcpy(values, source_values, sizeof(int) * count);
+    }
+}
+
+void free_sort(void)
+{
+    free(scratch_keys);
+    free(scratch_values);
+}
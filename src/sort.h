@@ -0,0 +1,10 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdint.h>
+
+// Ordena de menor a mayor las claves junto a sus valores (estable, O(n))
+void radix_sort(uint32_t *keys, int *values, int count);
+void free_sort(void);
+
+#endif
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "stats.h"
+#include "thread_pool.h"
+
+#define CACHE_LINE_SIZE 64
+
+/////// Contadores del frame actual
+/////// Los hilos los suman de forma atómica, una vez por malla o por trabajo
+
+static SDL_atomic_t counters[NUM_STAT_COUNTERS];
+
+// Los rasterizadores suman una vez por triángulo y tile, así que cada hilo tiene
+// su propia fila en sus propias líneas de caché y las filas se suman al leerlas
+typedef struct thread_counters_t
+{
+    int values[NUM_STAT_COUNTERS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_counters_t;
+
+static thread_counters_t thread_counters[MAX_THREADS];
+static __thread int stats_thread = 0; // fila del hilo actual, igual que su rectángulo de recorte
+
+static const char *counter_names[NUM_STAT_COUNTERS] = {
+    "trivially rejected triangles",
+    "clipped triangles",
+    "shaded pixels",
+    "written pixels",
+    "resolved pixels",
+    "hi-z rejected triangles",
+    "hi-z rejected blocks",
+    "hi-z front triangles",
+    "culled meshes",
+    "visible meshes",
+    "bvh visited nodes",
+    "lod skipped faces",
+    "occluder triangles",
+    "occluded meshes",
+    "sort time (us)",
+    "frame arena (KB)",
+    "frame arena high-water mark (KB)",
+};
+
+void reset_frame_stats(void)
+{
+    for (int i = 0; i < NUM_STAT_COUNTERS; i++)
+        SDL_AtomicSet(&counters[i], 0);
+    memset(thread_counters, 0, sizeof(thread_counters));
+}
+
+void add_stat(int counter, int value)
+{
+    if (value != 0)
+        SDL_AtomicAdd(&counters[counter], value);
+}
+
+// Los trabajos que rasterizan indican el índice de su hilo en el pool
+void set_stats_thread(int thread_index)
+{
+    stats_thread = thread_index;
+}
+
+void add_thread_stat(int counter, int value)
+{
+    thread_counters[stats_thread].values[counter] += value;
+}
+
+int get_stat(int counter)
+{
+    int value = SDL_AtomicGet(&counters[counter]);
+    for (int i = 0; i < MAX_THREADS; i++)
+        value += thread_counters[i].values[counter];
+    return value;
+}
+
+void print_frame_stats(void)
+{
+    for (int i = 0; i < NUM_STAT_COUNTERS; i++)
+        printf("%s: %d\n", counter_names[i], get_stat(i));
+
+    // Lo que el test de profundidad ha descartado después de rasterizar (overdraw evitado)
+    printf("depth rejected pixels: %d\n", get_stat(STAT_SHADED_PIXELS) - get_stat(STAT_WRITTEN_PIXELS));
+    printf("\n");
+}
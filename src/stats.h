@@ -0,0 +1,34 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Contadores del frame actual para medir el coste de cada etapa
+enum stat_counter
+{
+    STAT_REJECTED_TRIANGLES,     // triángulos fuera del frustum descartados por sus outcodes
+    STAT_CLIPPED_TRIANGLES,      // triángulos que han pasado por el clipper
+    STAT_SHADED_PIXELS,          // píxeles que han pasado el test de cobertura
+    STAT_WRITTEN_PIXELS,         // píxeles que además han pasado el de profundidad
+    STAT_RESOLVED_PIXELS,        // píxeles sombreados por el resolve del buffer de visibilidad
+    STAT_HIZ_REJECTED_TRIANGLES, // triángulos descartados enteros por el Hi-Z
+    STAT_HIZ_REJECTED_BLOCKS,    // bloques de 8x8 descartados por el Hi-Z
+    STAT_HIZ_FRONT_TRIANGLES,    // triángulos delante de todo, sin test de profundidad
+    STAT_CULLED_MESHES,          // mallas fuera del frustum descartadas por su esfera o su caja
+    STAT_VISIBLE_MESHES,         // mallas que llegan a la etapa de geometría
+    STAT_BVH_VISITED_NODES,      // nodos de la jerarquía de la escena probados contra el frustum
+    STAT_LOD_SKIPPED_FACES,      // caras que se ahorran las mallas dibujadas con un nivel simplificado
+    STAT_OCCLUDER_TRIANGLES,     // triángulos rasterizados en el buffer de oclusión
+    STAT_OCCLUDED_MESHES,        // mallas ocultas que se saltan la etapa de geometría
+    STAT_SORT_MICROSECONDS,      // coste de ordenar los triángulos de delante hacia atrás
+    STAT_ARENA_KILOBYTES,        // memoria de la arena del frame usada en este frame
+    STAT_ARENA_HIGH_WATER_KILOBYTES, // máximo usado por la arena del frame desde el arranque
+    NUM_STAT_COUNTERS
+};
+
+void reset_frame_stats(void);
+void add_stat(int counter, int value);
+void set_stats_thread(int thread_index);
+void add_thread_stat(int counter, int value);
+int get_stat(int counter);
+void print_frame_stats(void);
+
+#endif
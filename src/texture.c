@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "texture.h"
 
 tex2_t tex2_clone(tex2_t *t)
@@ -7,4 +9,119 @@ tex2_t tex2_clone(tex2_t *t)
         t->u,
         t->v};
     return result;
-}
\ No newline at end of file
+}
+
+// Niveles que tiene una textura de este tamaño, solo el original si no hay mipmaps
+int get_num_texture_levels(int width, int height)
+{
+    int num_levels = 1;
+    while (TEXTURE_MIPMAPS && num_levels < MAX_TEXTURE_LEVELS && (width > 1 || height > 1))
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        num_levels++;
+    }
+    return num_levels;
+}
+
+// Cada nivel es la media de bloques de 2x2 del anterior (los bordes impares repiten la última fila/columna)
+static void build_texture_mips(texture_t *texture)
+{
+    int num_levels = get_num_texture_levels(texture->levels[0].width, texture->levels[0].height);
+    while (texture->num_levels < num_levels)
+    {
+        texture_level_t *source = &texture->levels[texture->num_levels - 1];
+        texture_level_t *level = &texture->levels[texture->num_levels];
+        level->width = source->width > 1 ? source->width / 2 : 1;
+        level->height = source->height > 1 ? source->height / 2 : 1;
+        level->texels = (uint32_t *)malloc(sizeof(uint32_t) * level->width * level->height);
+
+        for (int y = 0; y < level->height; y++)
+        {
+            int y0 = y * 2 < source->height ? y * 2 : source->height - 1;
+            int y1 = y * 2 + 1 < source->height ? y * 2 + 1 : source->height - 1;
+            for (int x = 0; x < level->width; x++)
+            {
+                int x0 = x * 2 < source->width ? x * 2 : source->width - 1;
+                int x1 = x * 2 + 1 < source->width ? x * 2 + 1 : source->width - 1;
+                uint32_t texels[4] = {
+                    source->texels[source->width * y0 + x0],
+                    source->texels[source->width * y0 + x1],
+                    source->texels[source->width * y1 + x0],
+                    source->texels[source->width * y1 + x1],
+                };
+
+                // Promediamos cada uno de los cuatro canales de 8 bits por separado
+                uint32_t result = 0;
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    uint32_t sum = 0;
+                    for (int i = 0; i < 4; i++)
+                        sum += (texels[i] >> shift) & 0xFF;
+                    result |= ((sum + 2) / 4) << shift;
+                }
+                level->texels[level->width * y + x] = result;
+            }
+        }
+        texture->num_levels++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy a decoded PNG into engine texels and build its mipmaps if enabled
+///////////////////////////////////////////////////////////////////////////////
+// Los PNG RGBA8 se copian tal cual (el rasterizador lee cada píxel como un
+// uint32_t); los RGB8 se amplían con alfa opaco al mismo orden de bytes
+///////////////////////////////////////////////////////////////////////////////
+texture_t *create_texture_from_png(upng_t *png)
+{
+    upng_format format = upng_get_format(png);
+    if (format != UPNG_RGBA8 && format != UPNG_RGB8)
+    {
+        fprintf(stderr, "Unsupported PNG format %d, only RGB8 and RGBA8 textures are supported.\n", format);
+        return NULL;
+    }
+
+    int width = upng_get_width(png);
+    int height = upng_get_height(png);
+    const unsigned char *pixels = upng_get_buffer(png);
+
+    texture_t *texture = (texture_t *)calloc(1, sizeof(texture_t));
+    texture_level_t *level = &texture->levels[0];
+    level->width = width;
+    level->height = height;
+    level->texels = (uint32_t *)malloc(sizeof(uint32_t) * width * height);
+    texture->num_levels = 1;
+
+    if (format == UPNG_RGBA8)
+        memcpy(level->texels, pixels, sizeof(uint32_t) * width * height);
+    else
+    {
+        unsigned char *bytes = (unsigned char *)level->texels;
+        for (int i = 0; i < width * height; i++)
+        {
+            bytes[i * 4 + 0] = pixels[i * 3 + 0];
+            bytes[i * 4 + 1] = pixels[i * 3 + 1];
+            bytes[i * 4 + 2] = pixels[i * 3 + 2];
+            bytes[i * 4 + 3] = 0xFF;
+        }
+    }
+
+    build_texture_mips(texture);
+    return texture;
+}
+
+void free_texture(texture_t *texture)
+{
+    if (texture->cache_file != NULL)
+    {
+        unmap_file(texture->cache_file);
+        free(texture->cache_file);
+    }
+    else
+    {
+        for (int i = 0; i < texture->num_levels; i++)
+            free(texture->levels[i].texels);
+    }
+    free(texture);
+}
@@ -3,6 +3,17 @@
 
 #include <stdint.h>
 #include "upng.h"
+#include "mapped_file.h"
+
+// Niveles de mipmap como máximo (hasta 32768x32768)
+#define MAX_TEXTURE_LEVELS 16
+
+// Generar los mipmaps al cargar cada textura. El rasterizador todavía muestrea
+// siempre el nivel 0, así que por defecto no se generan ni se guardan en la caché
+// (se puede cambiar al compilar, por ejemplo con -DTEXTURE_MIPMAPS=1)
+#ifndef TEXTURE_MIPMAPS
+#define TEXTURE_MIPMAPS 0
+#endif
 
 typedef struct tex2_t
 {
@@ -10,6 +21,27 @@ typedef struct tex2_t
     float v;
 } tex2_t;
 
+// Un nivel de la textura con un texel de 32 bits por píxel, los bytes en orden RGBA
+typedef struct texture_level_t
+{
+    int width;
+    int height;
+    uint32_t *texels;
+} texture_level_t;
+
+// Textura lista para muestrear, decodificada del PNG o proyectada desde su caché
+typedef struct texture_t
+{
+    int id; // posición en la caché de recursos, agrupa los triángulos al ordenarlos
+    texture_level_t levels[MAX_TEXTURE_LEVELS]; // levels[0] es la imagen original, el resto mipmaps
+    int num_levels;
+    mapped_file_t *cache_file; // caché a la que apuntan los texels si se cargó de ella, NULL si son propios
+} texture_t;
+
 tex2_t tex2_clone(tex2_t *t);
 
-#endif
\ No newline at end of file
+int get_num_texture_levels(int width, int height);
+texture_t *create_texture_from_png(upng_t *png);
+void free_texture(texture_t *texture);
+
+#endif
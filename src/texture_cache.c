@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "texture_cache.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Raw texture cache
+///////////////////////////////////////////////////////////////////////////////
+// Después de decodificar un PNG guardamos a su lado los texels de 32 bits (y
+// sus mipmaps si se generan) tal y como los lee el rasterizador. Las siguientes
+// veces el fichero se proyecta en solo lectura y la textura apunta dentro de
+// él: no hay inflate ni unfilter, y varios procesos del motor comparten las
+// mismas páginas de la caché de disco
+///////////////////////////////////////////////////////////////////////////////
+static char *get_cache_filename(char *png_filename)
+{
+    int length = strlen(png_filename) + strlen(TEXTURE_CACHE_EXTENSION) + 1;
+    char *filename = (char *)malloc(length);
+    snprintf(filename, length, "%s%s", png_filename, TEXTURE_CACHE_EXTENSION);
+    return filename;
+}
+
+static bool is_cache_valid(mapped_file_t *file)
+{
+    if (file->size < (int64_t)sizeof(texture_cache_header_t))
+        return false;
+
+    texture_cache_header_t *header = (texture_cache_header_t *)file->data;
+    if (header->magic != TEXTURE_CACHE_MAGIC || header->version != TEXTURE_CACHE_VERSION || header->endian_tag != TEXTURE_CACHE_ENDIAN_TAG)
+        return false;
+    if (header->format != TEXTURE_FORMAT_RGBA8 || header->num_levels < 1 || header->num_levels > MAX_TEXTURE_LEVELS)
+        return false;
+
+    // Cada nivel tiene que caber en el fichero y el primero medir lo que dice la cabecera
+    for (int i = 0; i < header->num_levels; i++)
+    {
+        texture_cache_level_t *level = &header->levels[i];
+        if (level->width <= 0 || level->height <= 0)
+            return false;
+        if (level->offset < (int64_t)sizeof(texture_cache_header_t) || level->offset % TEXTURE_CACHE_ALIGNMENT != 0)
+            return false;
+        if (level->offset + (int64_t)sizeof(uint32_t) * level->width * level->height > file->size)
+            return false;
+    }
+    if (header->levels[0].width != header->width || header->levels[0].height != header->height)
+        return false;
+
+    // Una caché escrita con otra configuración de mipmaps se vuelve a generar
+    return header->num_levels == get_num_texture_levels(header->width, header->height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Map the cache of a PNG file, NULL if it does not exist or is not valid
+///////////////////////////////////////////////////////////////////////////////
+texture_t *map_texture_cache(char *png_filename, file_info_t *source_info, uint64_t *source_hash)
+{
+    char *cache_filename = get_cache_filename(png_filename);
+    mapped_file_t *file = (mapped_file_t *)malloc(sizeof(mapped_file_t));
+    bool is_mapped = map_file(cache_filename, file);
+    free(cache_filename);
+
+    if (!is_mapped || !is_cache_valid(file))
+    {
+        unmap_file(file);
+        free(file);
+        return NULL;
+    }
+
+    texture_cache_header_t *header = (texture_cache_header_t *)file->data;
+    source_info->mtime = header->source_mtime;
+    source_info->size = header->source_size;
+    *source_hash = header->source_hash;
+
+    texture_t *texture = (texture_t *)calloc(1, sizeof(texture_t));
+    for (int i = 0; i < header->num_levels; i++)
+    {
+        texture->levels[i].width = header->levels[i].width;
+        texture->levels[i].height = header->levels[i].height;
+        texture->levels[i].texels = (uint32_t *)(file->data + header->levels[i].offset);
+    }
+    texture->num_levels = header->num_levels;
+    texture->cache_file = file;
+    return texture;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Save the texels and mipmaps of a texture next to its PNG file
+///////////////////////////////////////////////////////////////////////////////
+void write_texture_cache(texture_t *texture, char *png_filename, file_info_t source_info, uint64_t source_hash)
+{
+    char *cache_filename = get_cache_filename(png_filename);
+    char *temporary_filename;
+
+    FILE *file = create_temporary_file(cache_filename, &temporary_filename);
+    if (file == NULL)
+    {
+        free(cache_filename);
+        return;
+    }
+
+    texture_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.endian_tag = TEXTURE_CACHE_ENDIAN_TAG;
+    header.format = TEXTURE_FORMAT_RGBA8;
+    header.width = texture->levels[0].width;
+    header.height = texture->levels[0].height;
+    header.num_levels = texture->num_levels;
+    header.source_mtime = source_info.mtime;
+    header.source_size = source_info.size;
+    header.source_hash = source_hash;
+
+    // La cabecera se reescribe al final con el desplazamiento de cada nivel
+    static const unsigned char zeros[TEXTURE_CACHE_ALIGNMENT] = {0};
+    fwrite(&header, sizeof(header), 1, file);
+    for (int i = 0; i < texture->num_levels; i++)
+    {
+        texture_level_t *level = &texture->levels[i];
+        int64_t position = ftell(file);
+        int64_t padding = (TEXTURE_CACHE_ALIGNMENT - position % TEXTURE_CACHE_ALIGNMENT) % TEXTURE_CACHE_ALIGNMENT;
+        fwrite(zeros, 1, padding, file);
+
+        header.levels[i].width = level->width;
+        header.levels[i].height = level->height;
+        header.levels[i].offset = position + padding;
+        fwrite(level->texels, sizeof(uint32_t), (size_t)level->width * level->height, file);
+    }
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    bool is_written = !ferror(file);
+    is_written = fclose(file) == 0 && is_written;
+    if (!is_written || !replace_file(temporary_filename, cache_filename))
+        remove(temporary_filename);
+
+    free(cache_filename);
+    free(temporary_filename);
+}
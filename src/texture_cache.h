@@ -0,0 +1,47 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stdint.h>
+#include "texture.h"
+#include "mapped_file.h"
+
+// La caché se guarda junto al PNG con esta extensión añadida (drone.png.tex)
+#define TEXTURE_CACHE_EXTENSION ".tex"
+#define TEXTURE_CACHE_MAGIC 0x58455454 // "TTEX" leído en little-endian
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_ENDIAN_TAG 0x01020304
+#define TEXTURE_CACHE_ALIGNMENT 64
+
+// Formato de los texels guardados, de momento solo el nativo del rasterizador
+enum texture_cache_format
+{
+    TEXTURE_FORMAT_RGBA8 = 1 // un uint32_t por texel con los bytes en orden RGBA
+};
+
+typedef struct texture_cache_level_t
+{
+    int32_t width;
+    int32_t height;
+    int64_t offset; // desde el inicio del fichero
+} texture_cache_level_t;
+
+typedef struct texture_cache_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t num_levels;  // 1 sin mipmaps
+    int32_t reserved;
+    int64_t source_mtime; // PNG del que sale la caché
+    int64_t source_size;
+    uint64_t source_hash;
+    texture_cache_level_t levels[MAX_TEXTURE_LEVELS];
+} texture_cache_header_t;
+
+texture_t *map_texture_cache(char *png_filename, file_info_t *source_info, uint64_t *source_hash);
+void write_texture_cache(texture_t *texture, char *png_filename, file_info_t source_info, uint64_t source_hash);
+
+#endif
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "thread_pool.h"
+
+// Lote de trabajos pedido por un hilo, vive en la pila de quien lo pide hasta que termina
+typedef struct job_batch_t
+{
+    job_function_t function;
+    void *data;
+    int num_jobs;
+    SDL_atomic_t next_job;
+    int active_threads; // hilos ejecutando trabajos del lote (con el mutex)
+    bool is_queued;     // aún puede quedar algún trabajo libre (con el mutex)
+    struct job_batch_t *next;
+} job_batch_t;
+
+/////// Estado compartido entre los hilos que piden trabajos y los workers
+static SDL_Thread *workers[MAX_THREADS];
+static SDL_threadID worker_ids[MAX_THREADS];
+static int num_threads = 1; // contando el hilo principal
+static SDL_mutex *mutex = NULL;
+static SDL_cond *work_available = NULL;
+static SDL_cond *batch_finished = NULL;
+static job_batch_t *batch_queue = NULL; // lotes con trabajos libres, el primero se atiende antes
+static bool is_quitting = false;
+
+// El hilo que crea el pool es el principal: trabaja en sus propios lotes con el
+// índice 0 y sus lotes pasan delante, así el frame no espera a la carga de
+// recursos. Otros hilos, como los de carga, pueden pedir lotes y esperan a que
+// los workers los terminen
+static SDL_threadID owner_thread = 0;
+
+// Cada hilo va cogiendo el siguiente trabajo libre del lote hasta que no quedan
+static void run_jobs(job_batch_t *batch, int thread_index)
+{
+    int job_index;
+    while ((job_index = SDL_AtomicAdd(&batch->next_job, 1)) < batch->num_jobs)
+        batch->function(batch->data, job_index, thread_index);
+}
+
+// Se llama con el mutex cuando un hilo sale de run_jobs: ya no quedan trabajos
+// libres, así que el lote deja la cola y acaba cuando salen todos sus hilos
+static void leave_batch(job_batch_t *batch)
+{
+    if (batch->is_queued)
+    {
+        job_batch_t **link = &batch_queue;
+        while (*link != batch)
+            link = &(*link)->next;
+        *link = batch->next;
+        batch->is_queued = false;
+    }
+    if (--batch->active_threads == 0)
+        SDL_CondBroadcast(batch_finished);
+}
+
+static int worker_main(void *data)
+{
+    int thread_index = (int)(intptr_t)data;
+
+    SDL_LockMutex(mutex);
+    worker_ids[thread_index] = SDL_ThreadID();
+    while (true)
+    {
+        while (!is_quitting && batch_queue == NULL)
+            SDL_CondWait(work_available, mutex);
+        if (is_quitting)
+        {
+            SDL_UnlockMutex(mutex);
+            return 0;
+        }
+        job_batch_t *batch = batch_queue;
+        batch->active_threads++;
+        SDL_UnlockMutex(mutex);
+
+        run_jobs(batch, thread_index);
+
+        SDL_LockMutex(mutex);
+        leave_batch(batch);
+    }
+}
+
+static bool is_worker_thread(void)
+{
+    SDL_threadID thread = SDL_ThreadID();
+    SDL_LockMutex(mutex);
+    bool is_worker = false;
+    for (int i = 1; i < num_threads; i++)
+        if (worker_ids[i] == thread)
+            is_worker = true;
+    SDL_UnlockMutex(mutex);
+    return is_worker;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Create the worker threads, 0 means one thread per CPU core
+///////////////////////////////////////////////////////////////////////////////
+void init_thread_pool(int threads)
+{
+    if (threads <= 0)
+        threads = SDL_GetCPUCount();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads < 1)
+        threads = 1;
+
+    owner_thread = SDL_ThreadID();
+    mutex = SDL_CreateMutex();
+    work_available = SDL_CreateCond();
+    batch_finished = SDL_CreateCond();
+
+    // El hilo principal también trabaja, así que creamos un worker menos
+    num_threads = 1;
+    for (int i = 1; i < threads; i++)
+    {
+        workers[i] = SDL_CreateThread(worker_main, "worker", (void *)(intptr_t)i);
+        if (workers[i] == NULL)
+        {
+            fprintf(stderr, "Error creating worker thread %d.\n", i);
+            break;
+        }
+        num_threads++;
+    }
+}
+
+int get_num_threads(void)
+{
+    return num_threads;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Run num_jobs jobs across all threads and wait until every one has finished
+///////////////////////////////////////////////////////////////////////////////
+// Lo puede llamar cualquier hilo. Un worker que pide trabajos desde otro
+// trabajo los ejecuta él mismo, esperar a los demás workers podría bloquearlos
+///////////////////////////////////////////////////////////////////////////////
+void run_parallel_jobs(job_function_t function, void *data, int num_jobs)
+{
+    bool is_owner = SDL_ThreadID() == owner_thread;
+    if (num_threads == 1 || (num_jobs <= 1 && is_owner) || (!is_owner && is_worker_thread()))
+    {
+        for (int i = 0; i < num_jobs; i++)
+            function(data, i, 0);
+        return;
+    }
+
+    job_batch_t batch = {
+        .function = function,
+        .data = data,
+        .num_jobs = num_jobs,
+        .active_threads = is_owner ? 1 : 0,
+        .is_queued = true,
+    };
+    SDL_AtomicSet(&batch.next_job, 0);
+
+    SDL_LockMutex(mutex);
+    job_batch_t **link = &batch_queue;
+    if (!is_owner)
+        while (*link != NULL)
+            link = &(*link)->next;
+    batch.next = *link;
+    *link = &batch;
+    SDL_CondBroadcast(work_available);
+
+    if (is_owner)
+    {
+        SDL_UnlockMutex(mutex);
+        run_jobs(&batch, 0);
+        SDL_LockMutex(mutex);
+        leave_batch(&batch);
+    }
+    while (batch.is_queued || batch.active_threads > 0)
+        SDL_CondWait(batch_finished, mutex);
+    SDL_UnlockMutex(mutex);
+}
+
+void destroy_thread_pool(void)
+{
+    SDL_LockMutex(mutex);
+    is_quitting = true;
+    SDL_CondBroadcast(work_available);
+    SDL_UnlockMutex(mutex);
+
+    for (int i = 1; i < num_threads; i++)
+        SDL_WaitThread(workers[i], NULL);
+    num_threads = 1;
+
+    SDL_DestroyCond(work_available);
+    SDL_DestroyCond(batch_finished);
+    SDL_DestroyMutex(mutex);
+}
@@ -0,0 +1,14 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#define MAX_THREADS 64
+
+// Cada trabajo recibe su índice y el del hilo que lo ejecuta (0 es el hilo principal)
+typedef void (*job_function_t)(void *data, int job_index, int thread_index);
+
+void init_thread_pool(int num_threads);
+int get_num_threads(void);
+void run_parallel_jobs(job_function_t function, void *data, int num_jobs);
+void destroy_thread_pool(void);
+
+#endif
@@ -0,0 +1,87 @@
+#include <math.h>
+#include "tile.h"
+#include "array.h"
+
+static tile_t *tiles = NULL;
+static int num_tiles_x = 0;
+static int num_tiles_y = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Split the screen in a grid of TILE_SIZE x TILE_SIZE tiles
+///////////////////////////////////////////////////////////////////////////////
+void init_tiles(int width, int height)
+{
+    num_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    num_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    tiles = (tile_t *)malloc(sizeof(tile_t) * num_tiles_x * num_tiles_y);
+
+    for (int ty = 0; ty < num_tiles_y; ty++)
+    {
+        for (int tx = 0; tx < num_tiles_x; tx++)
+        {
+            tile_t *tile = &tiles[(num_tiles_x * ty) + tx];
+            tile->rect.x = tx * TILE_SIZE;
+            tile->rect.y = ty * TILE_SIZE;
+            tile->rect.w = TILE_SIZE;
+            tile->rect.h = TILE_SIZE;
+            tile->triangles = NULL;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Bin every triangle into the tiles its screen bounding box overlaps
+///////////////////////////////////////////////////////////////////////////////
+// Los triángulos se añaden en el orden en que se enviaron, así dentro de cada
+// tile se dibujan en el mismo orden que en el renderizado serie y la imagen es
+// idéntica. El margen cubre lo que se dibuja fuera del triángulo (vértices, etc)
+///////////////////////////////////////////////////////////////////////////////
+void bin_triangles(triangle_t *triangles, int num_triangles, int margin)
+{
+    for (int i = 0; i < num_tiles_x * num_tiles_y; i++)
+        array_clear(tiles[i].triangles);
+
+    for (int i = 0; i < num_triangles; i++)
+    {
+        vec4_t *points = triangles[i].points;
+        float min_x = fminf(points[0].x, fminf(points[1].x, points[2].x)) - margin;
+        float min_y = fminf(points[0].y, fminf(points[1].y, points[2].y)) - margin;
+        float max_x = fmaxf(points[0].x, fmaxf(points[1].x, points[2].x)) + margin;
+        float max_y = fmaxf(points[0].y, fmaxf(points[1].y, points[2].y)) + margin;
+
+        int first_tx = (int)floorf(min_x) / TILE_SIZE;
+        int first_ty = (int)floorf(min_y) / TILE_SIZE;
+        int last_tx = (int)floorf(max_x) / TILE_SIZE;
+        int last_ty = (int)floorf(max_y) / TILE_SIZE;
+
+        first_tx = first_tx < 0 ? 0 : first_tx;
+        first_ty = first_ty < 0 ? 0 : first_ty;
+        last_tx = last_tx >= num_tiles_x ? num_tiles_x - 1 : last_tx;
+        last_ty = last_ty >= num_tiles_y ? num_tiles_y - 1 : last_ty;
+
+        for (int ty = first_ty; ty <= last_ty; ty++)
+        {
+            for (int tx = first_tx; tx <= last_tx; tx++)
+            {
+                array_push(tiles[(num_tiles_x * ty) + tx].triangles, i);
+            }
+        }
+    }
+}
+
+int get_num_tiles(void)
+{
+    return num_tiles_x * num_tiles_y;
+}
+
+tile_t *get_tile(int index)
+{
+    return &tiles[index];
+}
+
+void free_tiles(void)
+{
+    for (int i = 0; i < num_tiles_x * num_tiles_y; i++)
+        array_free(tiles[i].triangles);
+    free(tiles);
+}
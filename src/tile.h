@@ -0,0 +1,22 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include <SDL2/SDL.h>
+#include "triangle.h"
+
+// Tamaño en píxeles de cada tile de pantalla
+#define TILE_SIZE 64
+
+typedef struct tile_t
+{
+    SDL_Rect rect;  // región de la pantalla que cubre el tile
+    int *triangles; // array dinámico con los índices de los triángulos que lo tocan
+} tile_t;
+
+void init_tiles(int width, int height);
+void bin_triangles(triangle_t *triangles, int num_triangles, int margin);
+int get_num_tiles(void);
+tile_t *get_tile(int index);
+void free_tiles(void);
+
+#endif
@@ -0,0 +1,82 @@
+#include "transform.h"
+#include "camera.h"
+
+static mat4_t proj_matrix;
+static mat4_t view_matrix;
+
+// Se incrementa cada vez que cambia la vista o la proyección, así cada
+// transformación sabe si su model-view y su MVP han quedado obsoletas
+static unsigned int view_version = 0;
+
+void set_projection_matrix(mat4_t projection)
+{
+    proj_matrix = projection;
+    view_version++;
+}
+
+mat4_t get_projection_matrix(void)
+{
+    return proj_matrix;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rebuild the view matrix once per frame, only if the camera has changed
+///////////////////////////////////////////////////////////////////////////////
+void update_view_matrix(void)
+{
+    if (!is_camera_dirty())
+        return;
+
+    // Actualizamos el camera look at para crear la matriz de vista
+    vec3_t target = get_camera_lookat_target();
+    vec3_t up_direction = vec3_new(0, 1, 0);
+    view_matrix = mat4_look_at(get_camera_position(), target, up_direction);
+
+    clear_camera_dirty();
+    view_version++;
+}
+
+mat4_t get_view_matrix(void)
+{
+    return view_matrix;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Recompute only the cached matrices that depend on what has changed
+///////////////////////////////////////////////////////////////////////////////
+void update_transform(transform_t *transform, vec3_t scale, vec3_t rotation, vec3_t translation)
+{
+    bool world_changed = transform->is_dirty;
+
+    if (world_changed)
+    {
+        mat4_t scale_matrix = mat4_make_scale(scale.x, scale.y, scale.z);
+        mat4_t translation_matrix = mat4_make_translation(translation.x, translation.y, translation.z);
+        mat4_t rotation_matrix_x = mat4_make_rotation_x(rotation.x);
+        mat4_t rotation_matrix_y = mat4_make_rotation_y(rotation.y);
+        mat4_t rotation_matrix_z = mat4_make_rotation_z(rotation.z);
+
+        // Multiplicamos todas las matrices para cargar la matriz de mundo
+        // La matriz de la izquierda es la que transforma la matriz de la derecha
+        // IMPORTANTE: El orden de las transformaciones debe tenerse en cuenta
+        //             1. Escalar  2. Rotar  3. Trasladar
+        //                    [T] * [R] * [S] * v
+        mat4_t world_matrix = mat4_identity();
+        world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
+        world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
+        world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
+        world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
+        world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
+
+        transform->world_matrix = world_matrix;
+        transform->is_dirty = false;
+    }
+
+    // La model-view y la MVP dependen también de la cámara y la proyección
+    if (world_changed || transform->view_version != view_version)
+    {
+        transform->model_view_matrix = mat4_mul_mat4(view_matrix, transform->world_matrix);
+        transform->mvp_matrix = mat4_mul_mat4(proj_matrix, transform->model_view_matrix);
+        transform->view_version = view_version;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+
+// Caché de las matrices de transformación de un objeto de la escena
+// Solo se recalculan cuando cambia su escalado/rotación/traslación o la cámara
+typedef struct transform_t
+{
+    mat4_t world_matrix;      // [T] * [R] * [S]
+    mat4_t model_view_matrix; // [V] * [W] (espacio de cámara)
+    mat4_t mvp_matrix;        // [P] * [V] * [W] (espacio de recorte)
+    unsigned int view_version; // versión de vista/proyección usada en el último cálculo
+    bool is_dirty;             // escalado, rotación o traslación modificados
+} transform_t;
+
+void set_projection_matrix(mat4_t projection);
+mat4_t get_projection_matrix(void);
+
+void update_view_matrix(void);
+mat4_t get_view_matrix(void);
+
+void update_transform(transform_t *transform, vec3_t scale, vec3_t rotation, vec3_t translation);
+
+#endif
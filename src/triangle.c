@@ -1,8 +1,15 @@
 #include "triangle.h"
 #include "display.h"
 #include "swap.h"
+#include "simd.h"
+#include "stats.h"
+#include "hiz.h"
 #include <stdint.h>
 
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
 int int_crop(int num, int min, int max)
 {
     if (num < min)
@@ -19,6 +26,278 @@ void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t colo
     draw_line(x2, y2, x0, y0, color);
 }
 
+// Retorna las masas baricentricas alfa, beta y gama para el punto P
+//          A
+//         /|\
+//        / | \
+//       /  |  \
+//      /  (p)  \
+//     /  /   \  \
+//    / /       \ \
+//   B-------------C
+vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p)
+{
+    // Buscamos los vectores entre los vértices ABC y el punto P
+    vec2_t ab = vec2_sub(b, a);
+    vec2_t bc = vec2_sub(c, b);
+    vec2_t ac = vec2_sub(c, a);
+    vec2_t ap = vec2_sub(p, a);
+    vec2_t bp = vec2_sub(p, b);
+
+    // Calculamos la masa del triángulo completo ABC usando producto vectorial (área del paralelogramo)
+    float area_triangle_abc = (ab.x * ac.y - ab.y * ac.x);
+
+    // La masa alpha es el área del subtriángulo BCP dividio entre el área del triángulo completo ABC
+    float alpha = (bc.x * bp.y - bp.x * bc.y) / area_triangle_abc;
+
+    // La masa beta es el área del subtriángulo ACP dividio entre el área del triángulo completo ABC
+    float beta = (ap.x * ac.y - ac.x * ap.y) / area_triangle_abc;
+
+    // La masa gamma la encontramos fácilmente pues la suma de las tres masas es siempre 1 (área total)
+    float gamma = 1 - alpha - beta;
+
+    vec3_t weights = {alpha, beta, gamma};
+    return weights;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Triangle setup
+///////////////////////////////////////////////////////////////////////////////
+// Antes de rasterizar calculamos una sola vez por triángulo la ecuación de
+// plano en pantalla de cada atributo, a(x,y) = ddx*x + ddy*y + c. Así los
+// rasterizadores evalúan el plano al empezar una fila o un bloque y después
+// solo suman ddx al avanzar un píxel (y ddy al bajar una fila), sin volver a
+// dividir u, v y 1 entre w ni calcular las masas baricéntricas en cada píxel
+//
+// Con precisión subpíxel los vértices se guardan en punto fijo (SUBPIXEL_BITS
+// decimales) y se muestrea el centro de cada píxel (x + 0.5, y + 0.5), en
+// lugar de truncar los vértices y muestrear la esquina
+///////////////////////////////////////////////////////////////////////////////
+
+// Plano de un atributo a partir de su valor en los tres vértices del setup
+attribute_plane_t make_attribute_plane(triangle_setup_t *setup, float a0, float a1, float a2)
+{
+    attribute_plane_t plane = {0};
+    if (setup->area == 0)
+        return plane;
+
+    // Pasamos las posiciones en punto fijo a píxeles (la escala es potencia de 2, es exacta)
+    float scale = 1 << setup->subpixel_bits;
+    float dx1 = (setup->x[1] - setup->x[0]) / scale;
+    float dy1 = (setup->y[1] - setup->y[0]) / scale;
+    float dx2 = (setup->x[2] - setup->x[0]) / scale;
+    float dy2 = (setup->y[2] - setup->y[0]) / scale;
+    float area = setup->area / (scale * scale);
+
+    // Resolvemos a1 - a0 = ddx*dx1 + ddy*dy1 y a2 - a0 = ddx*dx2 + ddy*dy2 (regla de Cramer)
+    plane.ddx = ((a1 - a0) * dy2 - (a2 - a0) * dy1) / area;
+    plane.ddy = ((a2 - a0) * dx1 - (a1 - a0) * dx2) / area;
+
+    // Desplazamos el plano para que a(x,y) devuelva el valor en el punto de muestreo del píxel
+    float sample_offset = setup->subpixel_bits > 0 ? 0.5f : 0.0f;
+    plane.c = a0 - plane.ddx * (setup->x[0] / scale - sample_offset) - plane.ddy * (setup->y[0] / scale - sample_offset);
+    return plane;
+}
+
+float attribute_plane_at(attribute_plane_t plane, int x, int y)
+{
+    return plane.ddx * x + plane.ddy * y + plane.c;
+}
+
+void setup_triangle(triangle_t *triangle, triangle_setup_t *setup)
+{
+    // Redondeamos los vértices a 1/16 de píxel o, sin precisión subpíxel, los truncamos a píxeles
+    setup->subpixel_bits = is_subpixel_precision() ? SUBPIXEL_BITS : 0;
+    float scale = 1 << setup->subpixel_bits;
+    for (int i = 0; i < 3; i++)
+    {
+        if (setup->subpixel_bits > 0)
+        {
+            setup->x[i] = floorf(triangle->points[i].x * scale + 0.5f);
+            setup->y[i] = floorf(triangle->points[i].y * scale + 0.5f);
+        }
+        else
+        {
+            setup->x[i] = triangle->points[i].x;
+            setup->y[i] = triangle->points[i].y;
+        }
+    }
+    setup->area = (setup->x[1] - setup->x[0]) * (setup->y[2] - setup->y[0]) - (setup->y[1] - setup->y[0]) * (setup->x[2] - setup->x[0]);
+
+    float w0 = triangle->points[0].w;
+    float w1 = triangle->points[1].w;
+    float w2 = triangle->points[2].w;
+
+    // Volteamos el componente V para las coordenadas UV invertidas (V crece hacia abajo)
+    float v0 = 1.0 - triangle->texcoords[0].v;
+    float v1 = 1.0 - triangle->texcoords[1].v;
+    float v2 = 1.0 - triangle->texcoords[2].v;
+
+    // Rango de profundidad del triángulo para el Hi-Z (1/w interpolado nunca sale de él)
+    float max_reciprocal_w = fmaxf(1 / w0, fmaxf(1 / w1, 1 / w2));
+    float min_reciprocal_w = fminf(1 / w0, fminf(1 / w1, 1 / w2));
+    setup->min_depth = 1.0f - max_reciprocal_w;
+    setup->max_depth = 1.0f - min_reciprocal_w;
+
+    // Interpolamos 1/w, u/w y v/w porque son lineales en pantalla (corrección de perspectiva)
+    setup->reciprocal_w = make_attribute_plane(setup, 1 / w0, 1 / w1, 1 / w2);
+    setup->u_over_w = make_attribute_plane(setup, triangle->texcoords[0].u / w0, triangle->texcoords[1].u / w1, triangle->texcoords[2].u / w2);
+    setup->v_over_w = make_attribute_plane(setup, v0 / w0, v1 / w1, v2 / w2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Edge functions and pixel shading shared by the rasterizers
+///////////////////////////////////////////////////////////////////////////////
+typedef struct edge_t
+{
+    int step_x; // A: incremento al avanzar un píxel en x
+    int step_y; // B: incremento al avanzar un píxel en y
+    int offset; // C: valor en el punto de muestreo del píxel (0,0)
+} edge_t;
+
+// Arista de (x0,y0) a (x1,y1) en punto fijo, positiva a la izquierda según el producto vectorial
+//
+// Con precisión subpíxel aplicamos la regla top-left: un píxel cuyo centro cae
+// justo sobre la arista solo es del triángulo si es una arista superior
+// (horizontal con el interior debajo) o izquierda (el interior a su derecha).
+// Dos triángulos que comparten una arista la recorren en sentidos opuestos,
+// así que cada píxel de la arista se sombrea exactamente una vez
+static edge_t make_edge(int x0, int y0, int x1, int y1, int subpixel_bits)
+{
+    int a = y0 - y1;
+    int b = x1 - x0;
+    int c = (y1 - y0) * x0 - (x1 - x0) * y0;
+
+    edge_t edge = {
+        .step_x = a * (1 << subpixel_bits),
+        .step_y = b * (1 << subpixel_bits),
+        .offset = c};
+
+    if (subpixel_bits > 0)
+    {
+        // Muestreamos el centro del píxel, medio píxel en punto fijo
+        int half_pixel = 1 << (subpixel_bits - 1);
+        edge.offset += a * half_pixel + b * half_pixel;
+
+        // Las aristas que no son top-left excluyen el valor 0 (E >= 0 pasa a ser E > 0)
+        bool is_top_left = a > 0 || (a == 0 && b > 0);
+        if (!is_top_left)
+            edge.offset -= 1;
+    }
+    return edge;
+}
+
+static int edge_at(edge_t edge, int x, int y)
+{
+    return edge.step_x * x + edge.step_y * y + edge.offset;
+}
+
+// Las tres aristas del triángulo orientadas para que el interior quede en su lado positivo
+// (si el área es negativa recorremos los vértices al revés, los planos no cambian)
+static void make_triangle_edges(triangle_setup_t *setup, edge_t edges[3])
+{
+    int b = setup->area > 0 ? 1 : 2;
+    int c = setup->area > 0 ? 2 : 1;
+    edges[0] = make_edge(setup->x[b], setup->y[b], setup->x[c], setup->y[c], setup->subpixel_bits);
+    edges[1] = make_edge(setup->x[c], setup->y[c], setup->x[0], setup->y[0], setup->subpixel_bits);
+    edges[2] = make_edge(setup->x[0], setup->y[0], setup->x[b], setup->y[b], setup->subpixel_bits);
+}
+
+// Lo que necesita el sombreado de cada píxel además de los planos del setup
+typedef struct pixel_shader_t
+{
+    uint32_t color;
+    texture_t *texture;
+    uint32_t *texture_buffer;
+    int texture_width;
+    int texture_height;
+    bool is_in_front;   // el Hi-Z garantiza que pasa el test de profundidad
+    bool is_visibility; // escribe el color (el identificador del triángulo) en el buffer de visibilidad
+    int written_pixels; // píxeles que han pasado el test de profundidad (overdraw)
+} pixel_shader_t;
+
+static pixel_shader_t make_pixel_shader(uint32_t color, texture_t *texture)
+{
+    pixel_shader_t shader = {.color = color, .texture = texture};
+    if (texture != NULL)
+    {
+        // El rasterizador todavía no elige mipmap, siempre muestrea el nivel 0
+        shader.texture_buffer = texture->levels[0].texels;
+        shader.texture_width = texture->levels[0].width;
+        shader.texture_height = texture->levels[0].height;
+    }
+    return shader;
+}
+
+// Color del píxel con los valores de 1/w, u/w y v/w interpolados para él
+static uint32_t shade_color(float reciprocal_w, float u_over_w, float v_over_w, pixel_shader_t *shader)
+{
+    if (shader->texture == NULL)
+        return shader->color;
+
+    // Dividimos de vuelta u/w y v/w por 1/w y mapeamos la UV al tamaño de la textura
+    float interpolated_u = u_over_w / reciprocal_w;
+    float interpolated_v = v_over_w / reciprocal_w;
+
+    int tex_x = abs((int)(interpolated_u * shader->texture_width)) % shader->texture_width;
+    int tex_y = abs((int)(interpolated_v * shader->texture_height)) % shader->texture_height;
+
+    return shader->texture_buffer[(shader->texture_width * tex_y) + tex_x];
+}
+
+// Dibuja el píxel (x,y) si pasa el test de profundidad
+static void shade_pixel(int x, int y, float reciprocal_w, float u_over_w, float v_over_w, pixel_shader_t *shader)
+{
+    // Ajustamos 1/w para que los píxeles más cercanos a la cámara tengan un valor menor
+    float depth = 1.0f - reciprocal_w;
+
+    // Solo dibujaremos el pixel si el valor de la profunidad es menor al que había anteriormente en el z-buffer
+    if (!shader->is_in_front && depth >= get_zbuffer_at(x, y))
+        return;
+    shader->written_pixels++;
+
+    if (shader->is_visibility)
+        draw_visibility_pixel(x, y, shader->color);
+    else
+        draw_pixel(x, y, shade_color(reciprocal_w, u_over_w, v_over_w, shader));
+
+    // Actualizamos el z-buffer con el valor 1/w para el pixel actual
+    update_zbuffer_at(x, y, depth);
+}
+
+// Hi-Z por triángulo, con su caja ya recortada al rectángulo de recorte: si queda
+// detrás de lo dibujado en todos los tiles que toca se descarta entero y si queda
+// delante de todo se puede dibujar sin comparar con el z-buffer
+static bool test_triangle_hiz(triangle_setup_t *setup, pixel_shader_t *shader, int min_x, int min_y, int max_x, int max_y)
+{
+    if (min_x > max_x || min_y > max_y)
+        return false;
+    if (!is_hiz_culling())
+        return true;
+
+    if (setup->min_depth - HIZ_EPSILON >= get_hiz_max(min_x, min_y, max_x, max_y))
+    {
+        add_thread_stat(STAT_HIZ_REJECTED_TRIANGLES, 1);
+        return false;
+    }
+
+    shader->is_in_front = setup->max_depth + HIZ_EPSILON < get_hiz_min(min_x, min_y, max_x, max_y);
+    add_thread_stat(STAT_HIZ_FRONT_TRIANGLES, shader->is_in_front);
+    return true;
+}
+
+// Lo dibujado por el triángulo puede estar tan cerca como su vértice más cercano
+static void finish_triangle(triangle_setup_t *setup, pixel_shader_t *shader, int min_x, int min_y, int max_x, int max_y, int shaded_pixels)
+{
+    add_thread_stat(STAT_SHADED_PIXELS, shaded_pixels);
+    add_thread_stat(STAT_WRITTEN_PIXELS, shader->written_pixels);
+    if (shaded_pixels > 0)
+        lower_hiz_min(min_x, min_y, max_x, max_y, setup->min_depth - HIZ_EPSILON);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Scanline rasterizer
+///////////////////////////////////////////////////////////////////////////////
 // Para rasterizar un triángulo lo partiremos en dos mitades trazando un plano de y1 a My
 // Conseguiremos así un triángulo con un lado plano superior y otro con un lado plano inferior
 //
@@ -39,39 +318,142 @@ void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t colo
 //                           \
 //                         (x2,y2)
 //
-void draw_filled_triangle(
-    int x0, int y0, float z0, float w0,
-    int x1, int y1, float z1, float w1,
-    int x2, int y2, float z2, float w2,
-    uint32_t color)
+
+// Dibuja los píxeles de la fila y entre x_start y x_end que estén dentro del triángulo
+// y devuelve cuántos se han sombreado
+static int draw_scanline_span(int y, int x_start, int x_end, edge_t edges[3], triangle_setup_t *setup, pixel_shader_t *shader)
+{
+    // Solo recorremos las columnas dentro del rectángulo de recorte (el tile actual)
+    SDL_Rect clip = get_clip_rect();
+    x_start = int_crop(x_start, clip.x, clip.x + clip.w);
+    x_end = int_crop(x_end, clip.x - 1, clip.x + clip.w - 1);
+    if (x_start > x_end)
+        return 0;
+
+    // Evaluamos las aristas y los planos al inicio de la fila, después solo sumamos sus incrementos
+    int w0 = edge_at(edges[0], x_start, y);
+    int w1 = edge_at(edges[1], x_start, y);
+    int w2 = edge_at(edges[2], x_start, y);
+    float reciprocal_w = attribute_plane_at(setup->reciprocal_w, x_start, y);
+    float u_over_w = attribute_plane_at(setup->u_over_w, x_start, y);
+    float v_over_w = attribute_plane_at(setup->v_over_w, x_start, y);
+    int shaded_pixels = 0;
+
+    for (int x = x_start; x <= x_end; x++)
+    {
+        // Las pendientes redondeadas pueden salirse del triángulo, lo descartamos con las aristas
+        if ((w0 | w1 | w2) >= 0)
+        {
+            shade_pixel(x, y, reciprocal_w, u_over_w, v_over_w, shader);
+            shaded_pixels++;
+        }
+
+        w0 += edges[0].step_x;
+        w1 += edges[1].step_x;
+        w2 += edges[2].step_x;
+        reciprocal_w += setup->reciprocal_w.ddx;
+        u_over_w += setup->u_over_w.ddx;
+        v_over_w += setup->v_over_w.ddx;
+    }
+    return shaded_pixels;
+}
+
+// División entera redondeando hacia abajo (b > 0), la de C redondea hacia cero
+static int floor_div(int a, int b)
 {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Recorta el tramo [x_start, x_end] de la fila y a los píxeles dentro de las tres aristas:
+// E(x) = E(0,y) + A*x >= 0 da un límite izquierdo si A > 0 y uno derecho si A < 0
+static bool clip_span_to_edges(edge_t edges[3], int y, int *x_start, int *x_end)
+{
+    for (int e = 0; e < 3; e++)
+    {
+        int value = edge_at(edges[e], 0, y);
+        int step = edges[e].step_x;
+        if (step > 0)
+        {
+            int first = -floor_div(value, step); // ceil(-value / step)
+            if (first > *x_start)
+                *x_start = first;
+        }
+        else if (step < 0)
+        {
+            int last = floor_div(value, -step);
+            if (last < *x_end)
+                *x_end = last;
+        }
+        else if (value < 0)
+        {
+            return false; // arista horizontal y la fila entera queda fuera
+        }
+    }
+    return *x_start <= *x_end;
+}
+
+static void rasterize_scanline_triangle(triangle_setup_t *setup, pixel_shader_t *shader)
+{
+    if (setup->area == 0)
+        return;
+
+    edge_t edges[3];
+    make_triangle_edges(setup, edges);
+
+    // Las scanlines se recorren en píxeles enteros, las aristas deciden qué píxeles entran
+    int x0 = setup->x[0] >> setup->subpixel_bits, y0 = setup->y[0] >> setup->subpixel_bits;
+    int x1 = setup->x[1] >> setup->subpixel_bits, y1 = setup->y[1] >> setup->subpixel_bits;
+    int x2 = setup->x[2] >> setup->subpixel_bits, y2 = setup->y[2] >> setup->subpixel_bits;
+    int shaded_pixels = 0;
+
     // 1. Ordenamos los vértics por la cordenada-y de forma ascendente (y0 < y1 < y2)
+    // Los atributos están en los planos del setup, así que solo hay que ordenar las posiciones
     if (y0 > y1)
     {
         int_swap(&y0, &y1);
         int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
     }
     if (y1 > y2)
     {
         int_swap(&y1, &y2);
         int_swap(&x1, &x2);
-        float_swap(&z1, &z2);
-        float_swap(&w1, &w2);
     }
     if (y0 > y1)
     {
         int_swap(&y0, &y1);
         int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
     }
 
-    // Aquí creamos puntos de vector y coordenadas de texturas después de ordenar los vértices
-    vec4_t point_a = {x0, y0, z0, w0};
-    vec4_t point_b = {x1, y1, z1, w1};
-    vec4_t point_c = {x2, y2, z2, w2};
+    // Solo recorremos las filas dentro del rectángulo de recorte (el tile actual)
+    SDL_Rect clip = get_clip_rect();
+    int clip_max_x = clip.x + clip.w - 1;
+    int clip_max_y = clip.y + clip.h - 1;
+
+    // Caja contenedora recortada para el Hi-Z
+    int min_x = x0 < x1 ? (x0 < x2 ? x0 : x2) : (x1 < x2 ? x1 : x2);
+    int max_x = x0 > x1 ? (x0 > x2 ? x0 : x2) : (x1 > x2 ? x1 : x2);
+    int box_min_x = int_crop(min_x, clip.x, clip_max_x + 1);
+    int box_max_x = int_crop(max_x, clip.x - 1, clip_max_x);
+    int box_min_y = int_crop(y0, clip.y, clip_max_y + 1);
+    int box_max_y = int_crop(y2, clip.y - 1, clip_max_y);
+    if (!test_triangle_hiz(setup, shader, box_min_x, box_min_y, box_max_x, box_max_y))
+        return;
+
+    // Con precisión subpíxel las pendientes truncadas dejarían huecos y repetirían la fila y1,
+    // así que cada fila se recorre una sola vez con el tramo exacto que dan las aristas
+    if (setup->subpixel_bits > 0)
+    {
+        for (int y = box_min_y; y <= box_max_y; y++)
+        {
+            int x_start = min_x;
+            int x_end = max_x;
+            if (clip_span_to_edges(edges, y, &x_start, &x_end))
+                shaded_pixels += draw_scanline_span(y, x_start, x_end, edges, setup, shader);
+        }
+
+        finish_triangle(setup, shader, box_min_x, box_min_y, box_max_x, box_max_y, shaded_pixels);
+        return;
+    }
 
     // Renderizamos la parte superior del triángulo (flat-bottom)
     float inv_slope_1 = 0;
@@ -84,7 +466,7 @@ void draw_filled_triangle(
 
     if (y1 - y0 != 0)
     {
-        for (int y = y0; y <= y1; y++)
+        for (int y = int_crop(y0, clip.y, clip_max_y + 1); y <= int_crop(y1, clip.y - 1, clip_max_y); y++)
         {
             int x_start = x1 + (y - y1) * inv_slope_1;
             int x_end = x0 + (y - y0) * inv_slope_2;
@@ -96,11 +478,7 @@ void draw_filled_triangle(
                 int_swap(&x_start, &x_end);
             }
 
-            for (int x = x_start; x <= x_end; x++)
-            {
-                // Dibujamos el pixel con un color solido
-                draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
-            }
+            shaded_pixels += draw_scanline_span(y, x_start, x_end, edges, setup, shader);
         }
     }
 
@@ -115,7 +493,7 @@ void draw_filled_triangle(
 
     if (y2 - y1 != 0)
     {
-        for (int y = y1; y <= y2; y++)
+        for (int y = int_crop(y1, clip.y, clip_max_y + 1); y <= int_crop(y2, clip.y - 1, clip_max_y); y++)
         {
             int x_start = x1 + (y - y1) * inv_slope_1;
             int x_end = x0 + (y - y0) * inv_slope_2;
@@ -123,271 +501,529 @@ void draw_filled_triangle(
             if (x_end < x_start)
                 int_swap(&x_start, &x_end); // intercambiamos si x_start está a la derecha de x_end
 
-            for (int x = x_start; x <= x_end; x++)
-            {
-                // Dibujamos el pixel con un color solido
-                draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
-            }
+            shaded_pixels += draw_scanline_span(y, x_start, x_end, edges, setup, shader);
         }
     }
+
+    finish_triangle(setup, shader, box_min_x, box_min_y, box_max_x, box_max_y, shaded_pixels);
 }
 
-// Retorna las masas baricentricas alfa, beta y gama para el punto P
-//          A
-//         /|\
-//        / | \
-//       /  |  \
-//      /  (p)  \
-//     /  /   \  \
-//    / /       \ \
-//   B-------------C
-vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p)
+// Triángulo de color sólido con el rasterizador de scanlines
+void draw_filled_triangle(triangle_setup_t *setup, uint32_t color)
 {
-    // Buscamos los vectores entre los vértices ABC y el punto P
-    vec2_t ab = vec2_sub(b, a);
-    vec2_t bc = vec2_sub(c, b);
-    vec2_t ac = vec2_sub(c, a);
-    vec2_t ap = vec2_sub(p, a);
-    vec2_t bp = vec2_sub(p, b);
-
-    // Calculamos la masa del triángulo completo ABC usando producto vectorial (área del paralelogramo)
-    float area_triangle_abc = (ab.x * ac.y - ab.y * ac.x);
-
-    // La masa alpha es el área del subtriángulo BCP dividio entre el área del triángulo completo ABC
-    float alpha = (bc.x * bp.y - bp.x * bc.y) / area_triangle_abc;
-
-    // La masa beta es el área del subtriángulo ACP dividio entre el área del triángulo completo ABC
-    float beta = (ap.x * ac.y - ac.x * ap.y) / area_triangle_abc;
-
-    // La masa gamma la encontramos fácilmente pues la suma de las tres masas es siempre 1 (área total)
-    float gamma = 1 - alpha - beta;
+    pixel_shader_t shader = make_pixel_shader(color, NULL);
+    rasterize_scanline_triangle(setup, &shader);
+}
 
-    vec3_t weights = {alpha, beta, gamma};
-    return weights;
+// Dibujamos la textura del triángulo basada en el array texturizado de colores
+// Partimos el triángulo original en dos, el que es plano abajo y el que es plano arriba
+void draw_textured_triangle(triangle_setup_t *setup, texture_t *texture)
+{
+    pixel_shader_t shader = make_pixel_shader(0, texture);
+    rasterize_scanline_triangle(setup, &shader);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Function to draw the textured pixel at position (x,y) using depth interpolation
+// Half-space (edge function) rasterizer
 ///////////////////////////////////////////////////////////////////////////////
-void draw_triangle_texel(
-    int x, int y, upng_t *texture,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c,
-    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv)
-{
-    vec2_t p = {x, y};
-    vec2_t a = vec2_from_vec4(point_a);
-    vec2_t b = vec2_from_vec4(point_b);
-    vec2_t c = vec2_from_vec4(point_c);
+// En lugar de partir el triángulo en scanlines evaluamos las tres funciones de
+// arista E(x,y) = A*x + B*y + C sobre la caja que contiene al triángulo. Un píxel
+// está dentro si las tres son positivas y, al ser lineales, avanzar un píxel
+// solo suma A (en x) o B (en y). La caja se recorre en bloques de 8x8: si las
+// cuatro esquinas de un bloque quedan fuera de una arista se descarta entero, y
+// si quedan dentro de las tres todos sus píxeles están cubiertos y se dibujan
+// sin comprobar las aristas píxel a píxel
+///////////////////////////////////////////////////////////////////////////////
+#define RASTER_BLOCK_SIZE 8
 
-    vec3_t weights = barycentric_weights(a, b, c, p);
+///////////////////////////////////////////////////////////////////////////////
+// Kernels SIMD del rasterizador de aristas
+///////////////////////////////////////////////////////////////////////////////
+// Procesan una fila de un bloque de 4 (SSE2) u 8 (AVX2) píxeles a la vez: las
+// funciones de arista, la cobertura, 1/w y el test de profundidad se calculan
+// por carriles y el resultado se combina con una máscara antes de escribir el
+// color y el z-buffer con una sola carga/almacenamiento por fila. Solo la
+// lectura de la textura se hace carril a carril (el módulo no tiene
+// equivalente vectorial)
+///////////////////////////////////////////////////////////////////////////////
+#ifdef SIMD_X86
 
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
+// Texel de cada carril activo en la máscara, igual que en shade_pixel
+static void fetch_texels(pixel_shader_t *shader, const int32_t *tex_x, const int32_t *tex_y, int mask, uint32_t *texels)
+{
+    for (int i = 0; mask != 0; i++, mask >>= 1)
+    {
+        if (mask & 1)
+        {
+            int x = abs(tex_x[i]) % shader->texture_width;
+            int y = abs(tex_y[i]) % shader->texture_height;
+            texels[i] = shader->texture_buffer[(shader->texture_width * y) + x];
+        }
+    }
+}
 
-    // Check if the values of alpha beta and gamma are valid
-    const float EPSILON = 0.000001;
-    if (alpha < -EPSILON || beta < -EPSILON || gamma < -EPSILON)
-        return;
+__attribute__((target("sse2"))) static int rasterize_edge_block_sse2(
+    edge_t edges[3], triangle_setup_t *setup, pixel_shader_t *shader,
+    int block_x, int first_x, int last_x, int first_y, int last_y)
+{
+    int window_width = get_window_width();
+    uint32_t *color_buffer = shader->is_visibility ? get_visibility_buffer() : get_color_buffer();
+    float *z_buffer = get_z_buffer();
+
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i lane_x_min = _mm_set1_epi32(first_x - 1);
+    const __m128i lane_x_max = _mm_set1_epi32(last_x + 1);
+    const __m128i minus_one = _mm_set1_epi32(-1);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 rw_ddx = _mm_set1_ps(setup->reciprocal_w.ddx);
+    const __m128 uw_ddx = _mm_set1_ps(setup->u_over_w.ddx);
+    const __m128 vw_ddx = _mm_set1_ps(setup->v_over_w.ddx);
+    int shaded_pixels = 0;
+
+    // Incremento de cada arista entre los carriles (SSE2 no tiene multiplicación de enteros de 32 bits)
+    __m128i lane_step[3];
+    for (int e = 0; e < 3; e++)
+        lane_step[e] = _mm_setr_epi32(0, edges[e].step_x, edges[e].step_x * 2, edges[e].step_x * 3);
+
+    // Valor de los planos al inicio de la fila, al bajar una fila solo sumamos ddy
+    float row_rw = attribute_plane_at(setup->reciprocal_w, block_x, first_y);
+    float row_uw = attribute_plane_at(setup->u_over_w, block_x, first_y);
+    float row_vw = attribute_plane_at(setup->v_over_w, block_x, first_y);
+
+    for (int py = first_y; py <= last_y; py++)
+    {
+        for (int px = block_x; px < block_x + RASTER_BLOCK_SIZE; px += 4)
+        {
+            // Carriles dentro de la caja del triángulo y dentro de las tres aristas
+            __m128i lane_x = _mm_add_epi32(_mm_set1_epi32(px), lanes);
+            __m128i mask = _mm_and_si128(_mm_cmpgt_epi32(lane_x, lane_x_min), _mm_cmplt_epi32(lane_x, lane_x_max));
+
+            __m128i w0 = _mm_add_epi32(_mm_set1_epi32(edge_at(edges[0], px, py)), lane_step[0]);
+            __m128i w1 = _mm_add_epi32(_mm_set1_epi32(edge_at(edges[1], px, py)), lane_step[1]);
+            __m128i w2 = _mm_add_epi32(_mm_set1_epi32(edge_at(edges[2], px, py)), lane_step[2]);
+            mask = _mm_and_si128(mask, _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(w0, w1), w2), minus_one));
+            int coverage = _mm_movemask_ps(_mm_castsi128_ps(mask));
+            if (coverage == 0)
+                continue;
+            shaded_pixels += __builtin_popcount(coverage);
+
+            // Desplazamiento de cada carril respecto al inicio de la fila del bloque
+            __m128 lane_offset = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(px - block_x), lanes));
+            __m128 reciprocal_w = _mm_add_ps(_mm_set1_ps(row_rw), _mm_mul_ps(lane_offset, rw_ddx));
+            __m128 depth = _mm_sub_ps(one, reciprocal_w);
+
+            // Test de profundidad: pasa si no es depth >= z (igual que el escalar, también con NaN)
+            float *z_row = &z_buffer[(window_width * py) + px];
+            __m128 z = _mm_loadu_ps(z_row);
+            if (!shader->is_in_front)
+                mask = _mm_and_si128(mask, _mm_castps_si128(_mm_cmpnge_ps(depth, z)));
+            int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+            if (bits == 0)
+                continue;
+            shader->written_pixels += __builtin_popcount(bits);
+
+            __m128i color;
+            if (shader->texture == NULL)
+            {
+                color = _mm_set1_epi32(shader->color);
+            }
+            else
+            {
+                __m128 u = _mm_div_ps(_mm_add_ps(_mm_set1_ps(row_uw), _mm_mul_ps(lane_offset, uw_ddx)), reciprocal_w);
+                __m128 v = _mm_div_ps(_mm_add_ps(_mm_set1_ps(row_vw), _mm_mul_ps(lane_offset, vw_ddx)), reciprocal_w);
+
+                int32_t tex_x[4], tex_y[4];
+                uint32_t texels[4] = {0};
+                _mm_storeu_si128((__m128i *)tex_x, _mm_cvttps_epi32(_mm_mul_ps(u, _mm_set1_ps(shader->texture_width))));
+                _mm_storeu_si128((__m128i *)tex_y, _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(shader->texture_height))));
+                fetch_texels(shader, tex_x, tex_y, bits, texels);
+                color = _mm_loadu_si128((__m128i *)texels);
+            }
 
-    // Variables to store the interpolated values of U, V, and also 1/w for the current pixel
-    float interpolated_u;
-    float interpolated_v;
-    float interpolated_reciprocal_w;
+            // Escritura condicional: mezclamos con lo que ya había en los carriles descartados
+            uint32_t *color_row = &color_buffer[(window_width * py) + px];
+            __m128i old_color = _mm_loadu_si128((__m128i *)color_row);
+            _mm_storeu_si128((__m128i *)color_row, _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old_color)));
+            __m128 depth_mask = _mm_castsi128_ps(mask);
+            _mm_storeu_ps(z_row, _mm_or_ps(_mm_and_ps(depth_mask, depth), _mm_andnot_ps(depth_mask, z)));
+        }
 
-    // Perform the interpolation of all U/w and V/w values using barycentric weights and a factor of 1/w
-    interpolated_u = (a_uv.u / point_a.w) * alpha + (b_uv.u / point_b.w) * beta + (c_uv.u / point_c.w) * gamma;
-    interpolated_v = (a_uv.v / point_a.w) * alpha + (b_uv.v / point_b.w) * beta + (c_uv.v / point_c.w) * gamma;
+        row_rw += setup->reciprocal_w.ddy;
+        row_uw += setup->u_over_w.ddy;
+        row_vw += setup->v_over_w.ddy;
+    }
+    return shaded_pixels;
+}
 
-    // Also interpolate the value of 1/w for the current pixel
-    interpolated_reciprocal_w = (1 / point_a.w) * alpha + (1 / point_b.w) * beta + (1 / point_c.w) * gamma;
+__attribute__((target("avx2"))) static int rasterize_edge_block_avx2(
+    edge_t edges[3], triangle_setup_t *setup, pixel_shader_t *shader,
+    int block_x, int first_x, int last_x, int first_y, int last_y)
+{
+    int window_width = get_window_width();
+    uint32_t *color_buffer = shader->is_visibility ? get_visibility_buffer() : get_color_buffer();
+    float *z_buffer = get_z_buffer();
+
+    // Una fila del bloque de 8x8 ocupa exactamente un registro de 8 carriles
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i lane_x = _mm256_add_epi32(_mm256_set1_epi32(block_x), lanes);
+    const __m256i range_mask = _mm256_and_si256(_mm256_cmpgt_epi32(lane_x, _mm256_set1_epi32(first_x - 1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(last_x + 1), lane_x));
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    // Desplazamiento de los planos en cada carril respecto al inicio de la fila
+    const __m256 lane_offset = _mm256_cvtepi32_ps(lanes);
+    const __m256 lane_rw = _mm256_mul_ps(lane_offset, _mm256_set1_ps(setup->reciprocal_w.ddx));
+    const __m256 lane_uw = _mm256_mul_ps(lane_offset, _mm256_set1_ps(setup->u_over_w.ddx));
+    const __m256 lane_vw = _mm256_mul_ps(lane_offset, _mm256_set1_ps(setup->v_over_w.ddx));
+
+    __m256i w0 = _mm256_add_epi32(_mm256_set1_epi32(edge_at(edges[0], block_x, first_y)), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges[0].step_x)));
+    __m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(edge_at(edges[1], block_x, first_y)), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges[1].step_x)));
+    __m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(edge_at(edges[2], block_x, first_y)), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges[2].step_x)));
+    const __m256i step_y0 = _mm256_set1_epi32(edges[0].step_y);
+    const __m256i step_y1 = _mm256_set1_epi32(edges[1].step_y);
+    const __m256i step_y2 = _mm256_set1_epi32(edges[2].step_y);
+
+    __m256 rw = _mm256_add_ps(_mm256_set1_ps(attribute_plane_at(setup->reciprocal_w, block_x, first_y)), lane_rw);
+    __m256 uw = _mm256_add_ps(_mm256_set1_ps(attribute_plane_at(setup->u_over_w, block_x, first_y)), lane_uw);
+    __m256 vw = _mm256_add_ps(_mm256_set1_ps(attribute_plane_at(setup->v_over_w, block_x, first_y)), lane_vw);
+    const __m256 rw_ddy = _mm256_set1_ps(setup->reciprocal_w.ddy);
+    const __m256 uw_ddy = _mm256_set1_ps(setup->u_over_w.ddy);
+    const __m256 vw_ddy = _mm256_set1_ps(setup->v_over_w.ddy);
+    int shaded_pixels = 0;
+
+    for (int py = first_y; py <= last_y; py++)
+    {
+        __m256i mask = _mm256_and_si256(range_mask, _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(w0, w1), w2), minus_one));
+        __m256 reciprocal_w = rw;
+        __m256 u_over_w = uw;
+        __m256 v_over_w = vw;
+
+        // Al bajar una fila solo sumamos los incrementos en y de aristas y planos
+        w0 = _mm256_add_epi32(w0, step_y0);
+        w1 = _mm256_add_epi32(w1, step_y1);
+        w2 = _mm256_add_epi32(w2, step_y2);
+        rw = _mm256_add_ps(rw, rw_ddy);
+        uw = _mm256_add_ps(uw, uw_ddy);
+        vw = _mm256_add_ps(vw, vw_ddy);
+
+        int coverage = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+        if (coverage == 0)
+            continue;
+        shaded_pixels += __builtin_popcount(coverage);
+
+        __m256 depth = _mm256_sub_ps(one, reciprocal_w);
+
+        // Si el Hi-Z garantiza que el triángulo está delante ni siquiera leemos el z-buffer
+        float *z_row = &z_buffer[(window_width * py) + block_x];
+        if (!shader->is_in_front)
+            mask = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(depth, _mm256_loadu_ps(z_row), _CMP_NGE_UQ)));
+        int bits = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+        if (bits == 0)
+            continue;
+        shader->written_pixels += __builtin_popcount(bits);
+
+        __m256i color;
+        if (shader->texture == NULL)
+        {
+            color = _mm256_set1_epi32(shader->color);
+        }
+        else
+        {
+            __m256 u = _mm256_div_ps(u_over_w, reciprocal_w);
+            __m256 v = _mm256_div_ps(v_over_w, reciprocal_w);
+
+            int32_t tex_x[8], tex_y[8];
+            uint32_t texels[8] = {0};
+            _mm256_storeu_si256((__m256i *)tex_x, _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps(shader->texture_width))));
+            _mm256_storeu_si256((__m256i *)tex_y, _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(shader->texture_height))));
+            fetch_texels(shader, tex_x, tex_y, bits, texels);
+            color = _mm256_loadu_si256((__m256i *)texels);
+        }
 
-    // Now we can divide back both interpolated values by 1/w
-    interpolated_u /= interpolated_reciprocal_w;
-    interpolated_v /= interpolated_reciprocal_w;
+        // Con AVX2 la escritura enmascarada no toca los carriles descartados
+        uint32_t *color_row = &color_buffer[(window_width * py) + block_x];
+        _mm256_maskstore_epi32((int *)color_row, mask, color);
+        _mm256_maskstore_ps(z_row, mask, depth);
+    }
+    return shaded_pixels;
+}
 
-    // Conseguir el ancho y alto de la mesh
-    int texture_width = upng_get_width(texture);
-    int texture_height = upng_get_height(texture);
+#endif
 
-    // Map the UV coordinate to the full texture width and height
-    int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-    int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
+// Bloque de 8x8 (o la parte dentro de la caja del triángulo) píxel a píxel
+static int rasterize_edge_block_scalar(
+    edge_t edges[3], triangle_setup_t *setup, pixel_shader_t *shader, bool is_covered,
+    int first_x, int last_x, int first_y, int last_y)
+{
+    int shaded_pixels = 0;
 
-    // Adjust 1/w so the pixels that are closer to the camera have smaller values
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
+    // Aristas y planos en la primera fila del bloque, después solo sumamos incrementos
+    int row_w0 = edge_at(edges[0], first_x, first_y);
+    int row_w1 = edge_at(edges[1], first_x, first_y);
+    int row_w2 = edge_at(edges[2], first_x, first_y);
+    float row_rw = attribute_plane_at(setup->reciprocal_w, first_x, first_y);
+    float row_uw = attribute_plane_at(setup->u_over_w, first_x, first_y);
+    float row_vw = attribute_plane_at(setup->v_over_w, first_x, first_y);
 
-    // Y ESTO ES MIO: SOLO DIBUJAR EL PIXEL SI ESTA DENTRO DE LA PANTALLA: 0 > pixel > size
-    int pixel_position = (get_window_width() * y) + x;
-    int screen_pixels = get_window_width() * get_window_height();
-    if (pixel_position > 0 && pixel_position <= screen_pixels)
+    for (int py = first_y; py <= last_y; py++)
     {
-
-        // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer
-        if (interpolated_reciprocal_w < get_zbuffer_at(x, y))
+        int w0 = row_w0;
+        int w1 = row_w1;
+        int w2 = row_w2;
+        float reciprocal_w = row_rw;
+        float u_over_w = row_uw;
+        float v_over_w = row_vw;
+
+        for (int px = first_x; px <= last_x; px++)
         {
-            // Conseguir el buffer de colores de la textura
-            uint32_t *texture_buffer = (uint32_t *)upng_get_buffer(texture);
-
-            // Draw a pixel at position (x,y) with the color that comes from the mapped texture
-            draw_pixel(x, y, texture_buffer[(texture_width * tex_y) + tex_x]);
+            if (is_covered || (w0 | w1 | w2) >= 0)
+            {
+                shade_pixel(px, py, reciprocal_w, u_over_w, v_over_w, shader);
+                shaded_pixels++;
+            }
 
-            // Update the z-buffer value with the 1/w of this current pixel
-            update_zbuffer_at(x, y, interpolated_reciprocal_w);
+            w0 += edges[0].step_x;
+            w1 += edges[1].step_x;
+            w2 += edges[2].step_x;
+            reciprocal_w += setup->reciprocal_w.ddx;
+            u_over_w += setup->u_over_w.ddx;
+            v_over_w += setup->v_over_w.ddx;
         }
+
+        row_w0 += edges[0].step_y;
+        row_w1 += edges[1].step_y;
+        row_w2 += edges[2].step_y;
+        row_rw += setup->reciprocal_w.ddy;
+        row_uw += setup->u_over_w.ddy;
+        row_vw += setup->v_over_w.ddy;
     }
+    return shaded_pixels;
 }
 
-// Esta función dibuja un pixel solido en la posición (x,y) usando interpolación de profundidad
-void draw_triangle_pixel(
-    int x, int y, uint32_t color,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c)
-{
-    // Creamos los tres vec2 para encontrar la interpolación
-    vec2_t p = {x, y};
-    vec2_t a = vec2_from_vec4(point_a);
-    vec2_t b = vec2_from_vec4(point_b);
-    vec2_t c = vec2_from_vec4(point_c);
-
-    vec3_t weights = barycentric_weights(a, b, c, p);
+// Píxeles que debe dibujar un triángulo en un bloque para recalcular su max del Hi-Z
+#define HIZ_REFRESH_PIXELS (RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE / 4)
 
-    float alpha = weights.x; // en este contexto usamos el vector3
-    float beta = weights.y;
-    float gamma = weights.z;
+// El bloque (la parte que hay en pantalla) está dentro del rectángulo de recorte del hilo
+static bool is_block_inside_clip(int block_x, int block_y, SDL_Rect clip)
+{
+    int end_x = block_x + RASTER_BLOCK_SIZE < get_window_width() ? block_x + RASTER_BLOCK_SIZE : get_window_width();
+    int end_y = block_y + RASTER_BLOCK_SIZE < get_window_height() ? block_y + RASTER_BLOCK_SIZE : get_window_height();
+    return block_x >= clip.x && block_y >= clip.y && end_x <= clip.x + clip.w && end_y <= clip.y + clip.h;
+}
 
-    // Primera protección
-    const float EPSILON = 0.00001;
-    if (alpha < -EPSILON || beta < -EPSILON || gamma < -EPSILON)
+static void rasterize_edge_triangle(triangle_setup_t *setup, pixel_shader_t *shader)
+{
+    if (setup->area == 0)
         return;
 
-    float interpolated_reciprocal_w = (1 / point_a.w) * alpha + (1 / point_b.w) * beta + (1 / point_c.w) * gamma;
+    // Cada arista es opuesta a un vértice, orientadas para que el interior sea positivo
+    edge_t edges[3];
+    make_triangle_edges(setup, edges);
 
-    // Ajustamos 1/w para que los píxeles más cercanos a la cámara tengamos un valor menor
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
-
-    // Check if the drawing position is inside screen
-    // Margenes positivos -1 por que ese es el borde
-    x = int_crop(x, 0, get_window_width());
-    y = int_crop(y, 0, get_window_height());
-
-    // Solo dibujaremos el pixel si el valor de la profunidad es menor al que había anteriormente en el z-buffer
-    if (interpolated_reciprocal_w < get_zbuffer_at(x, y))
-    {
-        draw_pixel(x, y, color);
-
-        // Actualizamos el z-buffer con el valor 1/w para el pixel actual
-        update_zbuffer_at(x, y, interpolated_reciprocal_w);
-    }
-}
-
-// Dibujamos la textura del triángulo basada en el array texturizado de colores
-// Partimos el triángulo original en dos, el que es plano abajo y el que es plano arriba
-void draw_textured_triangle(
-    int x0, int y0, float z0, float w0, float u0, float v0,
-    int x1, int y1, float z1, float w1, float u1, float v1,
-    int x2, int y2, float z2, float w2, float u2, float v2,
-    upng_t *texture)
-{
-    // Necesitamos ordenar los vértices a partir de la coordenada Y ascendente (y0 < y1 < y2)
-    if (y0 > y1)
-    {
-        int_swap(&y0, &y1);
-        int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
-        float_swap(&u0, &u1);
-        float_swap(&v0, &v1);
-    }
-    if (y1 > y2)
-    {
-        int_swap(&y1, &y2);
-        int_swap(&x1, &x2);
-        float_swap(&z1, &z2);
-        float_swap(&w1, &w2);
-        float_swap(&u1, &u2);
-        float_swap(&v1, &v2);
-    }
-    if (y0 > y1)
+    // Caja contenedora del triángulo en píxeles recortada contra el rectángulo de recorte (tile actual)
+    int x[3], y[3];
+    for (int i = 0; i < 3; i++)
     {
-        int_swap(&y0, &y1);
-        int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
-        float_swap(&u0, &u1);
-        float_swap(&v0, &v1);
+        x[i] = setup->x[i] >> setup->subpixel_bits;
+        y[i] = setup->y[i] >> setup->subpixel_bits;
     }
+    SDL_Rect clip = get_clip_rect();
+    int min_x = int_crop(x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]), clip.x, clip.x + clip.w);
+    int min_y = int_crop(y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]), clip.y, clip.y + clip.h);
+    int max_x = int_crop(x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]), clip.x - 1, clip.x + clip.w - 1);
+    int max_y = int_crop(y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]), clip.y - 1, clip.y + clip.h - 1);
 
-    // Volteamos el componente V para las coordenadas UV invertidas (V crece hacia abajo)
-    v0 = 1.0 - v0;
-    v1 = 1.0 - v1;
-    v2 = 1.0 - v2;
+    if (!test_triangle_hiz(setup, shader, min_x, min_y, max_x, max_y))
+        return;
 
-    // Aquí creamos puntos de vector y coordenadas de texturas después de ordenar los vértices
-    vec4_t point_a = {x0, y0, z0, w0};
-    vec4_t point_b = {x1, y1, z1, w1};
-    vec4_t point_c = {x2, y2, z2, w2};
+    const int block_last = RASTER_BLOCK_SIZE - 1;
+    int screen_max_x = get_window_width() - 1;
+    int screen_max_y = get_window_height() - 1;
 
-    tex2_t a_uv = {u0, v0};
-    tex2_t b_uv = {u1, v1};
-    tex2_t c_uv = {u2, v2};
+    // Los kernels SIMD se usan solo con el rasterizador vectorial y si la CPU los soporta
+    int simd_level = get_raster_method() == RASTER_EDGE_SIMD ? get_simd_level() : SIMD_SCALAR;
+    int shaded_pixels = 0;
+    int hiz_rejected_blocks = 0;
 
-    // Renderizamos la parte superior del triángulo (flat-bottom)
-    float inv_slope_1 = 0;
-    float inv_slope_2 = 0;
-
-    if (y1 - y0 != 0)
-        inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0)
-        inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y1 - y0 != 0)
+    // Los bloques están alineados a la rejilla de 8x8 de la pantalla
+    for (int block_y = min_y & ~block_last; block_y <= max_y; block_y += RASTER_BLOCK_SIZE)
     {
-        for (int y = y0; y <= y1; y++)
+        for (int block_x = min_x & ~block_last; block_x <= max_x; block_x += RASTER_BLOCK_SIZE)
         {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
+            bool is_rejected = false;
+            bool is_covered = true;
 
-            if (x_end < x_start)
+            for (int e = 0; e < 3; e++)
             {
-                // intercambiamos si x_start está a la derecha de x_end
-                // así garantizamos que se puede dibujar correctamente
-                int_swap(&x_start, &x_end);
+                int e00 = edge_at(edges[e], block_x, block_y);
+                int e10 = e00 + edges[e].step_x * block_last;
+                int e01 = e00 + edges[e].step_y * block_last;
+                int e11 = e10 + edges[e].step_y * block_last;
+
+                // Las cuatro esquinas fuera de la arista: el bloque entero está fuera
+                if (e00 < 0 && e10 < 0 && e01 < 0 && e11 < 0)
+                {
+                    is_rejected = true;
+                    break;
+                }
+                // Alguna esquina fuera: habrá que comprobar esta arista píxel a píxel
+                if (e00 < 0 || e10 < 0 || e01 < 0 || e11 < 0)
+                    is_covered = false;
+            }
+            if (is_rejected)
+                continue;
+
+            // Profundidad más cercana y más lejana del triángulo dentro del bloque: 1/w es
+            // lineal en pantalla así que sus extremos están en las esquinas del bloque
+            float rw00 = attribute_plane_at(setup->reciprocal_w, block_x, block_y);
+            float rw10 = rw00 + setup->reciprocal_w.ddx * block_last;
+            float rw01 = rw00 + setup->reciprocal_w.ddy * block_last;
+            float rw11 = rw10 + setup->reciprocal_w.ddy * block_last;
+            float block_min_depth = fmaxf(1.0f - fmaxf(fmaxf(rw00, rw10), fmaxf(rw01, rw11)), setup->min_depth);
+            float block_max_depth = fminf(1.0f - fminf(fminf(rw00, rw10), fminf(rw01, rw11)), setup->max_depth);
+
+            // Hi-Z: el triángulo queda detrás de todo lo dibujado en el bloque
+            if (is_hiz_culling() && block_min_depth - HIZ_EPSILON >= get_hiz_block_max(block_x, block_y))
+            {
+                hiz_rejected_blocks++;
+                continue;
             }
 
-            for (int x = x_start; x <= x_end; x++)
+            // Recorremos solo la parte del bloque dentro de la caja del triángulo
+            int first_x = block_x > min_x ? block_x : min_x;
+            int first_y = block_y > min_y ? block_y : min_y;
+            int last_x = block_x + block_last < max_x ? block_x + block_last : max_x;
+            int last_y = block_y + block_last < max_y ? block_y + block_last : max_y;
+
+            int block_shaded_pixels = shaded_pixels;
+
+#ifdef SIMD_X86
+            // Los kernels leen y escriben la fila entera del bloque, así que el bloque
+            // debe caber horizontalmente en el rectángulo de recorte (si no, otro hilo
+            // podría estar escribiendo esos píxeles en su tile)
+            if (simd_level != SIMD_SCALAR && block_x >= clip.x && block_x + RASTER_BLOCK_SIZE <= clip.x + clip.w)
+            {
+                if (simd_level == SIMD_AVX2)
+                    shaded_pixels += rasterize_edge_block_avx2(edges, setup, shader, block_x, first_x, last_x, first_y, last_y);
+                else
+                    shaded_pixels += rasterize_edge_block_sse2(edges, setup, shader, block_x, first_x, last_x, first_y, last_y);
+            }
+            else
+#endif
+                shaded_pixels += rasterize_edge_block_scalar(edges, setup, shader, is_covered, first_x, last_x, first_y, last_y);
+
+            // Si el triángulo cubre todos los píxeles del bloque que hay en pantalla, ninguno
+            // queda más lejos que la profundidad máxima del triángulo en el bloque (cada píxel
+            // se queda con el mínimo entre lo que tenía y lo que acabamos de dibujar)
+            bool is_whole_block = first_x == block_x && first_y == block_y &&
+                                  last_x == (block_x + block_last < screen_max_x ? block_x + block_last : screen_max_x) &&
+                                  last_y == (block_y + block_last < screen_max_y ? block_y + block_last : screen_max_y);
+            if (is_covered && is_whole_block)
             {
-                // Dibujamos el texel de la sección pertinente interpolado
-                draw_triangle_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                lower_hiz_block_max(block_x, block_y, block_max_depth + HIZ_EPSILON);
+            }
+            else if (shaded_pixels - block_shaded_pixels >= HIZ_REFRESH_PIXELS && is_block_inside_clip(block_x, block_y, clip))
+            {
+                // Si el triángulo ha dibujado buena parte del bloque vale la pena leerlo
+                // entero del z-buffer para recalcular su max exacto
+                refresh_hiz_block_max(block_x, block_y);
             }
         }
     }
 
-    // Renderizamos la parte inferior del triangle (flat-top)
-    inv_slope_1 = 0;
-    inv_slope_2 = 0;
+    add_thread_stat(STAT_HIZ_REJECTED_BLOCKS, hiz_rejected_blocks);
+    finish_triangle(setup, shader, min_x, min_y, max_x, max_y, shaded_pixels);
+}
 
-    if (y2 - y1 != 0)
-        inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0)
-        inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
+// Triángulo de color sólido con el rasterizador de funciones de arista
+void draw_filled_triangle_edge(triangle_setup_t *setup, uint32_t color)
+{
+    pixel_shader_t shader = make_pixel_shader(color, NULL);
+    rasterize_edge_triangle(setup, &shader);
+}
 
-    if (y2 - y1 != 0)
+// Triángulo texturizado con el rasterizador de funciones de arista
+void draw_textured_triangle_edge(triangle_setup_t *setup, texture_t *texture)
+{
+    pixel_shader_t shader = make_pixel_shader(0, texture);
+    rasterize_edge_triangle(setup, &shader);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Visibility buffer
+///////////////////////////////////////////////////////////////////////////////
+// En lugar de texturizar cada píxel que pasa el test de profundidad (y que
+// quizás otro triángulo más cercano sobrescribe después) la primera pasada
+// solo escribe la profundidad y el identificador del triángulo (su índice + 1,
+// el 0 es el fondo). La segunda recorre la pantalla una vez y sombrea cada
+// píxel con los planos del setup de su triángulo, así el coste de texturizar
+// depende de la resolución y no de cuántos triángulos se solapan
+///////////////////////////////////////////////////////////////////////////////
+
+// El identificador es un color sólido más que se escribe en otro buffer
+static pixel_shader_t make_visibility_shader(uint32_t triangle_id)
+{
+    pixel_shader_t shader = make_pixel_shader(triangle_id, NULL);
+    shader.is_visibility = true;
+    return shader;
+}
+
+void draw_visibility_triangle(triangle_setup_t *setup, uint32_t triangle_id)
+{
+    pixel_shader_t shader = make_visibility_shader(triangle_id);
+    rasterize_scanline_triangle(setup, &shader);
+}
+
+void draw_visibility_triangle_edge(triangle_setup_t *setup, uint32_t triangle_id)
+{
+    pixel_shader_t shader = make_visibility_shader(triangle_id);
+    rasterize_edge_triangle(setup, &shader);
+}
+
+// Sombrea una sola vez cada píxel del rectángulo de recorte que tenga un triángulo visible
+void resolve_visibility_buffer(triangle_t *triangles, triangle_setup_t *setups)
+{
+    SDL_Rect clip = get_clip_rect();
+    int window_width = get_window_width();
+    uint32_t *visibility_buffer = get_visibility_buffer();
+    uint32_t *color_buffer = get_color_buffer();
+    bool is_textured = should_render_textured_triangle();
+
+    // Los píxeles vecinos suelen ser del mismo triángulo, solo cambiamos de shader cuando no
+    uint32_t current_id = 0;
+    pixel_shader_t shader = {0};
+    int resolved_pixels = 0;
+
+    for (int y = clip.y; y < clip.y + clip.h; y++)
     {
-        for (int y = y1; y <= y2; y++)
+        for (int x = clip.x; x < clip.x + clip.w; x++)
         {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
+            uint32_t triangle_id = visibility_buffer[(window_width * y) + x];
+            if (triangle_id == 0)
+                continue;
 
-            if (x_end < x_start)
-                int_swap(&x_start, &x_end); // intercambiamos si x_start está a la derecha de x_end
+            triangle_t *triangle = &triangles[triangle_id - 1];
+            triangle_setup_t *setup = &setups[triangle_id - 1];
+            if (triangle_id != current_id)
+            {
+                // Mismo shader que habría usado el render directo con el método actual
+                shader = is_textured ? make_pixel_shader(0, triangle->texture) : make_pixel_shader(triangle->color, NULL);
+                current_id = triangle_id;
+            }
 
-            for (int x = x_start; x <= x_end; x++)
-                // Dibujamos el texel de la sección pertinente interpolado
-                draw_triangle_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+            // Los planos se evalúan directamente en el píxel, sin incrementos
+            float reciprocal_w = attribute_plane_at(setup->reciprocal_w, x, y);
+            float u_over_w = attribute_plane_at(setup->u_over_w, x, y);
+            float v_over_w = attribute_plane_at(setup->v_over_w, x, y);
+            color_buffer[(window_width * y) + x] = shade_color(reciprocal_w, u_over_w, v_over_w, &shader);
+            resolved_pixels++;
         }
     }
+
+    add_thread_stat(STAT_RESOLVED_PIXELS, resolved_pixels);
 }
 
+
 vec3_t get_triangle_normal(vec4_t vertices[3])
 {
 
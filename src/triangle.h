@@ -2,9 +2,9 @@
 #define TRIANGLE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "vector.h"
 #include "texture.h"
-#include "upng.h"
 
 typedef struct face_t
 {
@@ -22,9 +22,48 @@ typedef struct triangle_t
     vec4_t points[3];
     tex2_t texcoords[3];
     int32_t color;
-    upng_t *texture;
+    texture_t *texture;
 } triangle_t;
 
+// Vértice de la malla transformado una única vez por frame y compartido por todas sus caras
+typedef struct transformed_vertex_t
+{
+    vec4_t camera_point; // posición en el espacio de la cámara
+    vec4_t screen_point; // posición proyectada en pantalla (solo válida si no hay que recortarlo)
+    int outcode;         // planos del frustum y de la guard band de los que queda fuera
+} transformed_vertex_t;
+
+// Ecuación de plano de un atributo en pantalla: a(x,y) = ddx*x + ddy*y + c
+typedef struct attribute_plane_t
+{
+    float ddx; // incremento al avanzar un píxel en x
+    float ddy; // incremento al avanzar un píxel en y
+    float c;
+} attribute_plane_t;
+
+// Bits de precisión subpíxel de los vértices en punto fijo (1/16 de píxel)
+#define SUBPIXEL_BITS 4
+
+// Lado máximo, en píxeles, del área que llega al rasterizador (pantalla más guard band).
+// Las áreas y funciones de arista suman dos productos de diferencias de coordenadas en
+// punto fijo de 32 bits: 2 * (2000 * 16)^2 = 2048000000 todavía cabe en 31 bits
+#define MAX_RASTER_EXTENT 2000
+
+// Setup de un triángulo: se calcula una vez por frame y lo comparten todos los rasterizadores
+// Un atributo nuevo solo necesita otro plano calculado con make_attribute_plane
+typedef struct triangle_setup_t
+{
+    int x[3];                       // vértices en punto fijo con subpixel_bits decimales
+    int y[3];
+    int subpixel_bits;              // 0 para vértices truncados a píxeles enteros
+    int area;                       // doble del área con signo, 0 si es degenerado
+    float min_depth;                // profundidad (1 - 1/w) más cercana de sus vértices
+    float max_depth;                // y más lejana
+    attribute_plane_t reciprocal_w; // 1/w
+    attribute_plane_t u_over_w;     // u/w
+    attribute_plane_t v_over_w;     // v/w (con V ya volteada)
+} triangle_setup_t;
+
 void int_swap(int *a, int *b);
 
 void draw_triangle(
@@ -33,26 +72,17 @@ void draw_triangle(
     int x2, int y2,
     uint32_t color);
 
-void draw_triangle_texel(
-    int x, int y, upng_t *texture,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c,
-    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv);
-
-void draw_triangle_pixel(
-    int x, int y, uint32_t color,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c);
-
-void draw_filled_triangle(
-    int x0, int y0, float z0, float w0,
-    int x1, int y1, float z1, float w1,
-    int x2, int y2, float z2, float w2,
-    uint32_t color);
+void setup_triangle(triangle_t *triangle, triangle_setup_t *setup);
+attribute_plane_t make_attribute_plane(triangle_setup_t *setup, float a0, float a1, float a2);
+float attribute_plane_at(attribute_plane_t plane, int x, int y);
 
-void draw_textured_triangle(
-    int x0, int y0, float z0, float w0, float u0, float v0,
-    int x1, int y1, float z1, float w1, float u1, float v1,
-    int x2, int y2, float z2, float w2, float u2, float v2,
-    upng_t *texture);
+void draw_filled_triangle(triangle_setup_t *setup, uint32_t color);
+void draw_textured_triangle(triangle_setup_t *setup, texture_t *texture);
+void draw_filled_triangle_edge(triangle_setup_t *setup, uint32_t color);
+void draw_textured_triangle_edge(triangle_setup_t *setup, texture_t *texture);
+void draw_visibility_triangle(triangle_setup_t *setup, uint32_t triangle_id);
+void draw_visibility_triangle_edge(triangle_setup_t *setup, uint32_t triangle_id);
+void resolve_visibility_buffer(triangle_t *triangles, triangle_setup_t *setups);
 
 vec3_t get_triangle_normal(vec4_t vertices[3]);
 
@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include "vertex_cache.h"
+#include "array.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Post-transform vertex cache optimization (Tipsify, Sander et al. 2007)
+///////////////////////////////////////////////////////////////////////////////
+// Emitimos las caras en abanicos alrededor de un vértice y saltamos al
+// siguiente vértice eligiendo entre los que acabamos de usar el que sigue en
+// la caché y le quedan caras, así los tres índices de cada cara suelen estar
+// recién transformados. Después renumeramos los vértices en el orden en que
+// las caras los usan por primera vez, para que tanto la transformación de los
+// vértices como las lecturas de cada cara recorran la memoria casi en línea
+///////////////////////////////////////////////////////////////////////////////
+
+// Simulamos una caché FIFO: un vértice está en caché si se insertó hace menos de cache_size fallos
+float get_mesh_acmr(mesh_geometry_t *geometry, int cache_size)
+{
+    int num_vertices = array_length(geometry->vertices);
+    int num_faces = array_length(geometry->faces);
+    if (num_faces == 0)
+        return 0;
+
+    int *inserted_at = (int *)malloc(sizeof(int) * (num_vertices + 1));
+    for (int i = 0; i < num_vertices; i++)
+        inserted_at[i] = -cache_size - 1;
+
+    int misses = 0;
+    for (int f = 0; f < num_faces; f++)
+    {
+        int corners[3] = {geometry->faces[f].a, geometry->faces[f].b, geometry->faces[f].c};
+        for (int j = 0; j < 3; j++)
+        {
+            if (misses - inserted_at[corners[j]] > cache_size)
+                inserted_at[corners[j]] = misses++;
+        }
+    }
+
+    free(inserted_at);
+    return (float)misses / num_faces;
+}
+
+// Siguiente vértice alrededor del que seguir emitiendo caras después de un abanico
+static int get_next_vertex(int *candidates, int num_candidates, int *live_faces, int *cache_time, int time,
+                           int *dead_end, int *dead_end_size, int *cursor, int num_vertices)
+{
+    // El candidato que más tiempo lleva en la caché pero que seguirá dentro después de
+    // emitir todas sus caras (cada una puede meter dos vértices nuevos)
+    int best = -1;
+    int best_priority = -1;
+    for (int i = 0; i < num_candidates; i++)
+    {
+        int v = candidates[i];
+        if (live_faces[v] <= 0)
+            continue;
+        int priority = 0;
+        if (time - cache_time[v] + 2 * live_faces[v] <= VERTEX_CACHE_SIZE)
+            priority = time - cache_time[v];
+        if (priority > best_priority)
+        {
+            best_priority = priority;
+            best = v;
+        }
+    }
+    if (best >= 0)
+        return best;
+
+    // Callejón sin salida: primero los vértices emitidos más recientemente, después en orden
+    while (*dead_end_size > 0)
+    {
+        int v = dead_end[--(*dead_end_size)];
+        if (live_faces[v] > 0)
+            return v;
+    }
+    while (*cursor < num_vertices)
+    {
+        if (live_faces[*cursor] > 0)
+            return *cursor;
+        (*cursor)++;
+    }
+    return -1;
+}
+
+static void reorder_faces(mesh_geometry_t *geometry)
+{
+    int num_vertices = array_length(geometry->vertices);
+    int num_faces = array_length(geometry->faces);
+    face_t *faces = geometry->faces;
+
+    // Caras de cada vértice en un solo array (offsets por recuento)
+    int *live_faces = (int *)calloc(num_vertices + 1, sizeof(int));
+    int *offsets = (int *)calloc(num_vertices + 1, sizeof(int));
+    int *vertex_faces = (int *)malloc(sizeof(int) * (num_faces * 3 + 1));
+    for (int f = 0; f < num_faces; f++)
+    {
+        live_faces[faces[f].a]++;
+        live_faces[faces[f].b]++;
+        live_faces[faces[f].c]++;
+    }
+    for (int v = 0; v < num_vertices; v++)
+        offsets[v + 1] = offsets[v] + live_faces[v];
+    int *fill = (int *)malloc(sizeof(int) * (num_vertices + 1));
+    for (int v = 0; v < num_vertices; v++)
+        fill[v] = offsets[v];
+    for (int f = 0; f < num_faces; f++)
+    {
+        vertex_faces[fill[faces[f].a]++] = f;
+        vertex_faces[fill[faces[f].b]++] = f;
+        vertex_faces[fill[faces[f].c]++] = f;
+    }
+
+    int *cache_time = (int *)calloc(num_vertices + 1, sizeof(int));
+    bool *is_emitted = (bool *)calloc(num_faces + 1, sizeof(bool));
+    int *dead_end = (int *)malloc(sizeof(int) * (num_faces * 3 + 1));
+    int *candidates = (int *)malloc(sizeof(int) * (num_faces * 3 + 1));
+    face_t *ordered_faces = NULL;
+
+    int dead_end_size = 0;
+    int cursor = 0;
+    int time = VERTEX_CACHE_SIZE + 1;
+    int fanning = num_faces > 0 ? faces[0].a : -1;
+
+    while (fanning >= 0)
+    {
+        int num_candidates = 0;
+        for (int i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+        {
+            int f = vertex_faces[i];
+            if (is_emitted[f])
+                continue;
+
+            int corners[3] = {faces[f].a, faces[f].b, faces[f].c};
+            for (int j = 0; j < 3; j++)
+            {
+                int v = corners[j];
+                dead_end[dead_end_size++] = v;
+                candidates[num_candidates++] = v;
+                live_faces[v]--;
+                if (time - cache_time[v] > VERTEX_CACHE_SIZE)
+                    cache_time[v] = time++;
+            }
+            is_emitted[f] = true;
+            array_push(ordered_faces, faces[f]);
+        }
+
+        fanning = get_next_vertex(candidates, num_candidates, live_faces, cache_time, time,
+                                  dead_end, &dead_end_size, &cursor, num_vertices);
+    }
+
+    array_free(geometry->faces);
+    geometry->faces = ordered_faces;
+
+    free(live_faces);
+    free(offsets);
+    free(vertex_faces);
+    free(fill);
+    free(cache_time);
+    free(is_emitted);
+    free(dead_end);
+    free(candidates);
+}
+
+// Renumeramos los vértices en el orden en que las caras los usan por primera vez
+static void renumber_vertices(mesh_geometry_t *geometry)
+{
+    int num_vertices = array_length(geometry->vertices);
+    int num_faces = array_length(geometry->faces);
+
+    int *remap = (int *)malloc(sizeof(int) * (num_vertices + 1));
+    for (int v = 0; v < num_vertices; v++)
+        remap[v] = -1;
+
+    vec3_t *ordered_vertices = NULL;
+    for (int f = 0; f < num_faces; f++)
+    {
+        int *corners[3] = {&geometry->faces[f].a, &geometry->faces[f].b, &geometry->faces[f].c};
+        for (int j = 0; j < 3; j++)
+        {
+            if (remap[*corners[j]] < 0)
+            {
+                remap[*corners[j]] = array_length(ordered_vertices);
+                array_push(ordered_vertices, geometry->vertices[*corners[j]]);
+            }
+            *corners[j] = remap[*corners[j]];
+        }
+    }
+
+    // Los vértices que no usa ninguna cara van al final
+    for (int v = 0; v < num_vertices; v++)
+        if (remap[v] < 0)
+            array_push(ordered_vertices, geometry->vertices[v]);
+
+    array_free(geometry->vertices);
+    geometry->vertices = ordered_vertices;
+    free(remap);
+
+    // Las posiciones SoA siguen el nuevo orden (el número de vértices no cambia)
+    if (geometry->positions_x != NULL)
+    {
+        for (int v = 0; v < num_vertices; v++)
+        {
+            geometry->positions_x[v] = geometry->vertices[v].x;
+            geometry->positions_y[v] = geometry->vertices[v].y;
+            geometry->positions_z[v] = geometry->vertices[v].z;
+        }
+    }
+}
+
+void optimize_mesh_vertex_cache(mesh_geometry_t *geometry)
+{
+    if (array_length(geometry->faces) == 0)
+        return;
+
+    reorder_faces(geometry);
+    renumber_vertices(geometry);
+}
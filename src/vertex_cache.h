@@ -0,0 +1,13 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include "mesh.h"
+
+// Tamaño de la caché FIFO de vértices transformados que simulamos para ordenar
+// las caras y medir el ACMR (fallos de caché por triángulo, de 0.5 a 3)
+#define VERTEX_CACHE_SIZE 16
+
+float get_mesh_acmr(mesh_geometry_t *geometry, int cache_size);
+void optimize_mesh_vertex_cache(mesh_geometry_t *geometry);
+
+#endif